@@ -0,0 +1,41 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+namespace sib::benchmark {
+
+// Stops the optimiser from discarding value, or assuming it has not changed.
+template<typename T>
+void do_not_optimize(T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static_cast<void volatile const&>(*reinterpret_cast<char volatile const*>(&value));
+#endif
+}
+
+/*
+ * Runs body iterations times and prints the mean time per iteration.
+ * Returns that mean, in nanoseconds.
+ */
+template<typename Body>
+double measure(char const* name, long iterations, Body&& body)
+{
+    auto const start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        body(i);
+    }
+    std::chrono::duration<double, std::nano> const elapsed = std::chrono::steady_clock::now() - start;
+    auto const mean = elapsed.count() / static_cast<double>(iterations);
+    std::printf("%-40s %12.2f ns\n", name, mean);
+    return mean;
+}
+
+}
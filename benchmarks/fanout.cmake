@@ -0,0 +1,34 @@
+# Copyright Stewart Becker 2024.
+# Distributed under the Boost Software License, Version 1.0.
+# (See accompanying file LICENSE_1_0.txt or copy at
+# https://www.boost.org/LICENSE_1_0.txt)
+
+# Compiles fanout.cpp with when_all over 8, 32 and 128 operands, and with the equivalent fold of operator& over 8 and 32
+# (beyond which it takes too long to be worth waiting for), reporting the time taken and the size of each object.
+# Run as: cmake -DCXX=<compiler> -DFLAGS=<flags> -DSOURCE=<fanout.cpp> -DINCLUDE=<include dir> -DOUTPUT=<dir> -P fanout.cmake
+
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+file(MAKE_DIRECTORY "${OUTPUT}")
+
+function(measure name operands)
+    set(object "${OUTPUT}/fanout_${name}_${operands}.o")
+    string(TIMESTAMP start "%s" UTC)
+    execute_process(
+            COMMAND "${CXX}" ${flags} -std=c++17 -I "${INCLUDE}" -DOPERANDS=${operands} ${ARGN} -c "${SOURCE}" -o "${object}"
+            RESULT_VARIABLE result
+    )
+    string(TIMESTAMP end "%s" UTC)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Failed to compile ${name} over ${operands} operands")
+    endif()
+    math(EXPR seconds "${end} - ${start}")
+    file(SIZE "${object}" bytes)
+    message("${name} ${operands}: ${seconds} s, ${bytes} bytes")
+endfunction()
+
+foreach(operands 8 32 128)
+    measure(when_all ${operands})
+endforeach()
+foreach(operands 8 32)
+    measure(fold ${operands} -DFOLD)
+endforeach()
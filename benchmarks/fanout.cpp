@@ -0,0 +1,43 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+// A compile-time benchmark: builds when_all over OPERANDS tasks, or with FOLD defined, the equivalent chain of
+// operator&.  fanout.cmake compiles it at several sizes, reporting the time taken and the size of the object.
+
+#include "sib/monad/task.h"
+#include <cstdio>
+#include <utility>
+
+#ifndef OPERANDS
+#define OPERANDS 8
+#endif
+
+namespace {
+
+template<std::size_t I>
+std::packaged_task<int()> operand()
+{
+    return std::packaged_task<int()>{[] { return static_cast<int>(I); }};
+}
+
+template<std::size_t... Is>
+int fan_out(sib::monad::in manner, std::index_sequence<Is...>)
+{
+    using namespace sib::monad;
+    auto const sum = [](auto... results) { return (results + ...); };
+#ifdef FOLD
+    return ((manner & ... & operand<Is>()) | apply(sum)) | get();
+#else
+    return when_all(manner, operand<Is>()...) | apply(sum) | get();
+#endif
+}
+
+}
+
+int main()
+{
+    auto const indices = std::make_index_sequence<OPERANDS>{};
+    std::printf("%d %d\n", fan_out(sib::monad::in::sequence, indices), fan_out(sib::monad::in::parallel, indices));
+}
@@ -0,0 +1,94 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+// Blocks 100,000 pipelines at once on a fiber_executor, all waiting on the same shared_task, then releases them.
+// On a thread_pool, the number of pipelines that can be blocked at once is the number of threads.
+
+#include "benchmark.h"
+#include "sib/fiber_executor.h"
+#include "sib/monad/task.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace {
+
+// Resident memory in KiB, from /proc.
+long resident_kib()
+{
+    std::ifstream status{"/proc/self/status"};
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+    return -1;
+}
+
+}
+
+int main()
+{
+    using namespace sib::monad;
+    using clock = std::chrono::steady_clock;
+    constexpr int pipelines = 100'000;
+
+    // A gate held shut by another thread, so that every pipeline calling it must wait.
+    std::promise<long> open;
+    std::atomic<bool> entered{false};
+    sib::shared_task<long()> const gate{[&entered, opened = open.get_future().share()] {
+        entered = true;
+        return opened.get();
+    }};
+    std::thread keeper{[gate] { gate(); }};
+    while (!entered) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<long> total{0};
+    std::atomic<int> blocked{0};
+    std::atomic<int> remaining{pipelines};
+    std::promise<void> done;
+    auto const before = resident_kib();
+    auto const start = clock::now();
+    {
+        // Unguarded stacks, since two mappings per stack would exceed the default vm.max_map_count.
+        sib::fiber_executor fibers{std::max(1u, std::thread::hardware_concurrency()), 32 * 1024, false};
+        for (int i = 0; i < pipelines; ++i) {
+            fibers.submit([&, i] {
+                ++blocked;
+                auto const result = gate | then([i](long x) { return x + i; }) | then([](long x) { return 2 * x; }) | get();
+                total += result;
+                if (--remaining == 0) {
+                    done.set_value();
+                }
+            });
+        }
+        while (blocked < pipelines) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        // Give the last fibers time to suspend.
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        std::chrono::duration<double, std::milli> const blocking = clock::now() - start;
+        auto const during = resident_kib();
+
+        auto const release = clock::now();
+        open.set_value(1);
+        done.get_future().get();
+        std::chrono::duration<double, std::milli> const releasing = clock::now() - release;
+
+        std::printf("%d pipelines blocked on %zu threads\n", pipelines, fibers.size());
+        std::printf("%-40s %12.2f ms\n", "start and block all", blocking.count());
+        std::printf("%-40s %12.2f ms\n", "release and finish all", releasing.count());
+        std::printf("%-40s %12.2f KiB\n", "resident memory per blocked pipeline",
+                    static_cast<double>(during - before) / pipelines);
+    }
+    keeper.join();
+
+    auto const expected = 2L * (pipelines + static_cast<long>(pipelines) * (pipelines - 1) / 2);
+    sib::benchmark::do_not_optimize(total);
+    return total == expected ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+// Compares a chain of optional | then(...) stages against the equivalent hand-written if-chain.
+// The stages are lambdas, as they usually are in practice, so that both versions can be inlined.
+
+#include "benchmark.h"
+#include "sib/monad/optional.h"
+#include <array>
+
+namespace {
+
+using Payload = std::array<long, 32>;
+
+auto const make = [](long seed) {
+    Payload p{};
+    p[0] = seed;
+    return p;
+};
+
+auto const scale = [](Payload p) {
+    for (auto& x : p) {
+        x = 3 * x + 1;
+    }
+    return p;
+};
+
+auto const check = [](Payload p) -> std::optional<Payload> {
+    return p[0] % 7 == 0 ? std::nullopt : std::optional<Payload>{p};
+};
+
+auto const sum = [](Payload const& p) {
+    long result = 0;
+    for (auto x : p) {
+        result += x;
+    }
+    return result;
+};
+
+}
+
+int main()
+{
+    using namespace sib::monad;
+    constexpr long iterations = 10'000'000;
+
+    auto const monadic = sib::benchmark::measure("optional | then(...) chain", iterations, [](long i) {
+        auto result = std::optional<long>{i} | then(make) | then(scale) | then(check) | then(scale) | then(sum);
+        sib::benchmark::do_not_optimize(result);
+    });
+
+    auto const by_hand = sib::benchmark::measure("hand-written if-chain", iterations, [](long i) {
+        std::optional<long> result;
+        std::optional<long> const input{i};
+        if (input) {
+            auto checked = check(scale(make(*input)));
+            if (checked) {
+                result.emplace(sum(scale(*checked)));
+            }
+        }
+        sib::benchmark::do_not_optimize(result);
+    });
+
+    std::printf("%-40s %12.2f\n", "ratio", monadic / by_hand);
+}
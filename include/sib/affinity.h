@@ -0,0 +1,151 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace sib::affinity {
+
+/*
+ * Parses a Linux cpulist, e.g. "0-3,8,10-11".
+ */
+inline std::vector<int> parse_cpulist(std::string const& list)
+{
+    std::vector<int> cpus;
+    std::istringstream stream{list};
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        auto const dash = range.find('-');
+        try {
+            auto const first = std::stoi(range.substr(0, dash));
+            auto const last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (auto cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (std::exception const&) {
+            // Ignore anything we cannot parse (e.g. trailing whitespace)
+        }
+    }
+    return cpus;
+}
+
+/*
+ * The CPUs belonging to each NUMA node, read from sysfs.
+ * Where there is no topology to read, all CPUs are reported as belonging to a single node.
+ */
+inline std::vector<std::vector<int>> const& numa_nodes()
+{
+    static std::vector<std::vector<int>> const nodes = [] {
+        std::vector<std::vector<int>> result;
+        for (int node = 0;; ++node) {
+            std::ifstream file{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+            std::string list;
+            if (!file || !std::getline(file, list)) {
+                break;
+            }
+            result.push_back(parse_cpulist(list));
+        }
+        if (result.empty()) {
+            result.emplace_back();
+            for (int cpu = 0, count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); cpu < count; ++cpu) {
+                result.back().push_back(cpu);
+            }
+        }
+        return result;
+    }();
+    return nodes;
+}
+
+/*
+ * Restricts the calling thread to the given CPUs.  An empty list means any CPU.
+ * Returns false if the thread's affinity could not be changed (including on platforms other than Linux).
+ */
+inline bool pin_this_thread(std::vector<int> const& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpus.empty()) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    for (auto cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    static_cast<void>(cpus);
+    return false;
+#endif
+}
+
+/*
+ * The CPUs the calling thread may currently run on.
+ */
+inline std::vector<int> this_thread_cpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+/*
+ * Pins the calling thread to a NUMA node for the lifetime of the scope, then restores its previous affinity.
+ * A node of -1, or one that does not exist, leaves the thread where it is.
+ */
+class node_scope
+{
+private:
+    std::vector<int> previous;
+    bool pinned;
+
+public:
+    explicit node_scope(int node) :
+        previous{},
+        pinned{false}
+    {
+        auto const& nodes = numa_nodes();
+        if (node >= 0 && static_cast<std::size_t>(node) < nodes.size()) {
+            previous = this_thread_cpus();
+            pinned = pin_this_thread(nodes[static_cast<std::size_t>(node)]);
+        }
+    }
+
+    node_scope(node_scope const&) = delete;
+    node_scope& operator=(node_scope const&) = delete;
+
+    ~node_scope() noexcept
+    {
+        if (pinned) {
+            pin_this_thread(previous);
+        }
+    }
+};
+
+}
@@ -0,0 +1,210 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/executor.h"
+#include "sib/shared_task.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace sib {
+
+template<typename Signature>
+class batch_task;
+
+/*
+ * batch_task coalesces concurrent single-key calls into bulk calls.
+ * Keys passed to load() within window of the first key of a batch (or until max_batch keys have arrived) are handed
+ * to one call of bulk, which must return one result per key, in the same order.  Each caller's result comes back
+ * through a shared_task<R()>, which composes with then, get, when_all and when_any like any other.
+ *
+ * Batches are dispatched by a thread belonging to the batch_task.  Copies share the same state and dispatcher,
+ * which flushes any keys still pending when the last copy is destroyed.
+ * If bulk throws, or returns the wrong number of results, every caller in that batch sees the exception.
+ */
+template<typename R, typename K>
+class batch_task<R(K)>
+{
+public:
+    using bulk_function = std::function<std::vector<R>(std::vector<K> const&)>;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Pending
+    {
+        K key;
+        std::promise<R> promise;
+        clock::time_point arrived;
+    };
+
+    class Impl
+    {
+    private:
+        bulk_function bulk;
+        clock::duration window;
+        std::size_t max_batch;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<Pending> pending;
+        bool stopping;
+        std::uint64_t batches;
+        std::uint64_t keys;
+        std::thread dispatcher;
+
+        void run(std::vector<Pending>& batch)
+        {
+            std::vector<K> batch_keys;
+            batch_keys.reserve(batch.size());
+            for (auto& p : batch) {
+                batch_keys.push_back(std::move(p.key));
+            }
+            try {
+                auto results = bulk(batch_keys);
+                if (results.size() != batch.size()) {
+                    throw std::length_error{"batch_task: bulk function returned the wrong number of results"};
+                }
+                for (std::size_t i = 0; i < batch.size(); ++i) {
+                    batch[i].promise.set_value(std::move(results[i]));
+                }
+            } catch (...) {
+                auto const error = std::current_exception();
+                for (auto& p : batch) {
+                    try {
+                        p.promise.set_exception(error);
+                    } catch (std::future_error const&) {
+                        // Already fulfilled before the exception
+                    }
+                }
+            }
+        }
+
+        void dispatch()
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            for (;;) {
+                wake.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (pending.empty()) {
+                    return;
+                }
+                wake.wait_until(lock, pending.front().arrived + window, [this] {
+                    return stopping || pending.size() >= max_batch;
+                });
+
+                std::vector<Pending> batch;
+                auto const size = std::min(pending.size(), max_batch);
+                batch.reserve(size);
+                for (std::size_t i = 0; i < size; ++i) {
+                    batch.push_back(std::move(pending.front()));
+                    pending.pop_front();
+                }
+                ++batches;
+                keys += size;
+
+                lock.unlock();
+                run(batch);
+                lock.lock();
+            }
+        }
+
+    public:
+        Impl(bulk_function bulk, clock::duration window, std::size_t max_batch) :
+            bulk{std::move(bulk)},
+            window{window},
+            max_batch{std::max<std::size_t>(1, max_batch)},
+            stopping{false},
+            batches{0},
+            keys{0}
+        {
+            dispatcher = std::thread{[this] { dispatch(); }};
+        }
+
+        Impl(Impl const&) = delete;
+        Impl& operator=(Impl const&) = delete;
+
+        ~Impl() noexcept
+        {
+            {
+                std::lock_guard<std::mutex> const lock{mutex};
+                stopping = true;
+            }
+            wake.notify_one();
+            dispatcher.join();
+        }
+
+        std::shared_future<R> enqueue(K key)
+        {
+            std::promise<R> promise;
+            auto future = promise.get_future().share();
+            {
+                std::lock_guard<std::mutex> const lock{mutex};
+                pending.push_back({std::move(key), std::move(promise), clock::now()});
+            }
+            // Either the dispatcher is idle and this is the first key, or the batch may now be full.
+            wake.notify_one();
+            return future;
+        }
+
+        std::uint64_t batch_count()
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            return batches;
+        }
+
+        std::uint64_t key_count()
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            return keys;
+        }
+    };
+
+    std::shared_ptr<Impl> impl;
+
+public:
+    explicit batch_task(bulk_function bulk,
+                        std::chrono::microseconds window = std::chrono::microseconds{100},
+                        std::size_t max_batch = 64) :
+        impl{std::make_shared<Impl>(std::move(bulk), window, max_batch)}
+    {}
+
+    /*
+     * Adds key to the next batch, and returns a task for its result.
+     * Calling the task waits (according to the current wait policy) for the batch to complete.
+     */
+    shared_task<R()> load(K key) const
+    {
+        return shared_task<R()>{[future = impl->enqueue(std::move(key))]() -> R {
+            current_wait_policy().wait(future);
+            return future.get();
+        }};
+    }
+
+    /*
+     * The number of bulk calls made, and the number of keys passed to them, so far.
+     */
+    std::uint64_t batches() const
+    {
+        return impl->batch_count();
+    }
+
+    std::uint64_t keys() const
+    {
+        return impl->key_count();
+    }
+};
+
+}
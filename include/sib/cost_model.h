@@ -0,0 +1,191 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <typeindex>
+#include <unordered_map>
+
+namespace sib {
+
+/*
+ * The thresholds by which a cost_model decides.
+ */
+struct cost_thresholds
+{
+    // Work estimated to take longer than this runs in parallel.
+    std::chrono::nanoseconds parallel_above = std::chrono::microseconds{50};
+    // Each sample moves the average 1/weight of the way towards itself.
+    std::int64_t weight = 8;
+};
+
+/*
+ * The decisions a cost_model has made, and the number of measurements it has taken.
+ */
+struct cost_counters
+{
+    std::uint64_t sequential = 0;
+    std::uint64_t parallel = 0;
+    std::uint64_t samples = 0;
+};
+
+class cost_model;
+
+namespace detail {
+
+inline cost_model*& cost_model_slot() noexcept
+{
+    static thread_local cost_model* current = nullptr;
+    return current;
+}
+
+}
+
+/*
+ * cost_model keeps an exponentially-weighted moving average of how long each kind of work takes when run in
+ * sequence, and uses it to decide whether running that work in parallel is worth the overhead.
+ * Work is identified by a std::type_index key.
+ *
+ * Work with no history runs in sequence, so that its cost can be measured.
+ */
+class cost_model
+{
+public:
+    using thresholds = cost_thresholds;
+    using counters = cost_counters;
+
+private:
+    struct Entry
+    {
+        std::int64_t average = 0;
+        std::uint64_t samples = 0;
+    };
+
+    mutable std::mutex mutex;
+    thresholds limits_;
+    counters counts;
+    std::unordered_map<std::type_index, Entry> entries;
+
+public:
+    explicit cost_model(thresholds limits = {}) :
+        limits_{limits}
+    {}
+
+    cost_model(cost_model const&) = delete;
+    cost_model& operator=(cost_model const&) = delete;
+
+    thresholds limits() const
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        return limits_;
+    }
+
+    void limits(thresholds limits)
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        limits_ = limits;
+    }
+
+    /*
+     * Records how long one sequential run of the work identified by key took.
+     */
+    void record(std::type_index key, std::chrono::nanoseconds cost)
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        auto& entry = entries[key];
+        entry.average = entry.samples == 0 ?
+            cost.count() :
+            entry.average + (cost.count() - entry.average) / std::max<std::int64_t>(1, limits_.weight);
+        ++entry.samples;
+        ++counts.samples;
+    }
+
+    std::optional<std::chrono::nanoseconds> estimate(std::type_index key) const
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        auto const entry = entries.find(key);
+        if (entry == entries.end()) {
+            return std::nullopt;
+        }
+        return std::chrono::nanoseconds{entry->second.average};
+    }
+
+    /*
+     * Decides whether to run the work identified by key in parallel, and counts the decision.
+     */
+    bool parallel(std::type_index key)
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        auto const entry = entries.find(key);
+        auto const result = entry != entries.end() && std::chrono::nanoseconds{entry->second.average} > limits_.parallel_above;
+        ++(result ? counts.parallel : counts.sequential);
+        return result;
+    }
+
+    counters decisions() const
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        return counts;
+    }
+
+    /*
+     * Forgets all history and zeroes the counters, keeping the thresholds.
+     */
+    void reset()
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        counts = {};
+        entries.clear();
+    }
+
+    /*
+     * The model shared by default.
+     */
+    static cost_model& global()
+    {
+        static cost_model model;
+        return model;
+    }
+
+    /*
+     * The innermost model in scope on this thread, or the global one.
+     */
+    static cost_model& current() noexcept
+    {
+        auto* model = detail::cost_model_slot();
+        return model ? *model : global();
+    }
+
+    /*
+     * Makes a model current on this thread for the lifetime of the scope, e.g. to keep a call site's statistics apart.
+     */
+    class scope
+    {
+    private:
+        cost_model* previous;
+
+    public:
+        explicit scope(cost_model& model) noexcept :
+            previous{detail::cost_model_slot()}
+        {
+            detail::cost_model_slot() = &model;
+        }
+
+        scope(scope const&) = delete;
+        scope& operator=(scope const&) = delete;
+
+        ~scope() noexcept
+        {
+            detail::cost_model_slot() = previous;
+        }
+    };
+};
+
+}
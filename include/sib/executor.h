@@ -0,0 +1,346 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/wait_policy.h"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace sib {
+
+/*
+ * Scheduling classes, most urgent first.
+ * inherit means the priority of the thread that submits the job.
+ */
+enum class priority : unsigned char { high, normal, low, inherit };
+
+static inline constexpr std::size_t priority_levels = 3;
+
+namespace detail {
+
+inline priority& priority_slot() noexcept
+{
+    static thread_local priority current = priority::normal;
+    return current;
+}
+
+}
+
+class executor;
+class tracker;
+
+namespace detail {
+
+inline executor*& executor_slot() noexcept
+{
+    static thread_local executor* current = nullptr;
+    return current;
+}
+
+inline tracker*& tracker_slot() noexcept
+{
+    static thread_local tracker* current = nullptr;
+    return current;
+}
+
+}
+
+/*
+ * The priority of the work running on this thread.  Jobs it spawns inherit it by default.
+ */
+inline priority current_priority() noexcept
+{
+    return detail::priority_slot();
+}
+
+/*
+ * Sets the calling thread's priority for the lifetime of the scope.
+ */
+class priority_scope
+{
+private:
+    priority previous;
+
+public:
+    explicit priority_scope(priority level) noexcept :
+        previous{detail::priority_slot()}
+    {
+        if (level != priority::inherit) {
+            detail::priority_slot() = level;
+        }
+    }
+
+    priority_scope(priority_scope const&) = delete;
+    priority_scope& operator=(priority_scope const&) = delete;
+
+    ~priority_scope() noexcept
+    {
+        detail::priority_slot() = previous;
+    }
+};
+
+/*
+ * A hint as to where and how urgently a job would like to run.
+ * node is a NUMA node index, or -1 for anywhere.
+ */
+struct placement
+{
+    int node = -1;
+    priority level = priority::inherit;
+};
+
+/*
+ * executor is the interface through which the library's parallel operations run their work.
+ * Each thread has a current executor (initially none), which executor::scope changes for the lifetime of the scope.
+ */
+class executor
+{
+private:
+    wait_policy waiting;
+
+public:
+    virtual ~executor() = default;
+
+    /*
+     * Queue a job, to be run as near to where as the executor can manage.
+     * Jobs must not throw.
+     */
+    virtual void submit(std::function<void()> job, placement where) = 0;
+
+    void submit(std::function<void()> job)
+    {
+        submit(std::move(job), placement{});
+    }
+
+    // Where a job submitted with a placement would run, relative to the calling thread.
+    enum class nearness { unplaced, here, elsewhere };
+
+    /*
+     * Whether this executor keeps workers near where.node itself and, if so, whether the calling thread is one of them.
+     * task | on(where) submits its work if it would run elsewhere, and pins its own thread only if unplaced.
+     */
+    virtual nearness near(placement /*where*/) const noexcept
+    {
+        return nearness::unplaced;
+    }
+
+    /*
+     * How threads whose current executor this is wait for results, unless a wait_policy::scope says otherwise.
+     * Set it before submitting work.
+     */
+    wait_policy const& waits() const noexcept
+    {
+        return waiting;
+    }
+
+    void waits(wait_policy policy) noexcept
+    {
+        waiting = std::move(policy);
+    }
+
+    /*
+     * The executor that the library's parallel operations on this thread will use, or nullptr.
+     */
+    static executor* current() noexcept
+    {
+        return detail::executor_slot();
+    }
+
+    class scope
+    {
+    private:
+        executor* previous;
+
+    public:
+        explicit scope(executor* exec) noexcept :
+            previous{detail::executor_slot()}
+        {
+            detail::executor_slot() = exec;
+        }
+
+        scope(scope const&) = delete;
+        scope& operator=(scope const&) = delete;
+
+        ~scope() noexcept
+        {
+            detail::executor_slot() = previous;
+        }
+    };
+};
+
+/*
+ * The wait policy for this thread: the innermost wait_policy::scope, else that of the current executor, else park.
+ */
+inline wait_policy const& current_wait_policy() noexcept
+{
+    if (auto const* policy = wait_policy::current()) {
+        return *policy;
+    }
+    if (auto const* exec = executor::current()) {
+        return exec->waits();
+    }
+    static wait_policy const park;
+    return park;
+}
+
+/*
+ * A tracker is told about every job spawned on a thread where it is current, and may wrap the job.
+ * sib::monad::scope uses this to account for, cancel and join the parallel work started under it.
+ */
+class tracker
+{
+public:
+    virtual ~tracker() = default;
+
+    // Returns the job to run in place of job.
+    virtual std::function<void()> track(std::function<void()> job) = 0;
+
+    // Starts a thread for a job when there is no current executor.
+    virtual void launch(std::function<void()> job)
+    {
+        std::thread{std::move(job)}.detach();
+    }
+
+    virtual bool cancelled() const noexcept
+    {
+        return false;
+    }
+
+    static tracker* current() noexcept
+    {
+        return detail::tracker_slot();
+    }
+
+    class scope
+    {
+    private:
+        tracker* previous;
+
+    public:
+        explicit scope(tracker* t) noexcept :
+            previous{detail::tracker_slot()}
+        {
+            detail::tracker_slot() = t;
+        }
+
+        scope(scope const&) = delete;
+        scope& operator=(scope const&) = delete;
+
+        ~scope() noexcept
+        {
+            detail::tracker_slot() = previous;
+        }
+    };
+};
+
+class spawned;
+
+template<typename Job>
+spawned spawn(Job&& job, placement where = {});
+
+/*
+ * The handle to a spawned job.
+ * A thread that needs the job's result may run the job itself if nobody has started it yet.
+ */
+class spawned
+{
+private:
+    struct State
+    {
+        std::atomic<bool> claimed{false};
+        std::function<void()> job;
+    };
+
+    std::shared_ptr<State> state;
+
+    template<typename Job>
+    friend spawned spawn(Job&& job, placement where);
+
+    explicit spawned(std::function<void()> job) :
+        state{std::make_shared<State>()}
+    {
+        state->job = std::move(job);
+    }
+
+    std::function<void()> runner() const
+    {
+        return [state = state] {
+            spawned{state}.try_run();
+        };
+    }
+
+    explicit spawned(std::shared_ptr<State> state) noexcept :
+        state{std::move(state)}
+    {}
+
+public:
+    /*
+     * Runs the job on the calling thread, unless it has already been started elsewhere.
+     * Returns whether it ran here.
+     */
+    bool try_run() const
+    {
+        if (state->claimed.exchange(true, std::memory_order_acq_rel)) {
+            return false;
+        }
+        auto job = std::move(state->job);
+        job();
+        return true;
+    }
+
+    /*
+     * Drops the job without running it, unless it has already been started.
+     * Anything waiting on the job's packaged_task then sees a broken promise.
+     * Returns whether it was dropped.
+     */
+    bool try_cancel() const
+    {
+        if (state->claimed.exchange(true, std::memory_order_acq_rel)) {
+            return false;
+        }
+        state->job = nullptr;
+        return true;
+    }
+};
+
+/*
+ * The library's single spawn point.
+ * job runs on the current executor if there is one, or on a new (detached) thread if not.
+ * If there is a current tracker, it sees the job first, and starts the thread if there is no executor.
+ */
+template<typename Job>
+spawned spawn(Job&& job, placement where)
+{
+    std::function<void()> function;
+    if constexpr (std::is_copy_constructible_v<std::decay_t<Job>>) {
+        function = std::forward<Job>(job);
+    } else {
+        // std::function must be copyable, so hold move-only jobs by shared_ptr.
+        function = [ptr = std::make_shared<std::decay_t<Job>>(std::forward<Job>(job))] { (*ptr)(); };
+    }
+
+    auto* const t = tracker::current();
+    if (t) {
+        function = t->track(std::move(function));
+    }
+
+    spawned result{std::move(function)};
+    if (auto* exec = executor::current()) {
+        exec->submit(result.runner(), where);
+    } else if (t) {
+        t->launch(result.runner());
+    } else {
+        std::thread{result.runner()}.detach();
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,440 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/cost_model.h"
+#include "sib/executor.h"
+#include "sib/wait_policy.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+namespace sib {
+
+namespace detail {
+
+/*
+ * A free list of fixed-size fiber stacks.
+ * Stacks are reserved with MAP_NORESERVE, so only the pages a fiber touches cost memory.
+ *
+ * Guarded stacks each get their own mapping, with an inaccessible page below to catch overflow.  That costs two of
+ * the process's memory mappings (see vm.max_map_count) per stack, so unguarded stacks are instead carved from slabs.
+ * Not thread-safe: each worker has its own.
+ */
+class StackPool
+{
+private:
+    static constexpr std::size_t slab_stacks = 64;
+
+    std::size_t page;
+    std::size_t size;
+    bool guarded;
+    std::vector<std::pair<void*, std::size_t>> mappings;
+    std::vector<void*> free;
+
+    void* map(std::size_t bytes)
+    {
+        auto* const mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (mapping == MAP_FAILED) {
+            throw std::bad_alloc{};
+        }
+        mappings.emplace_back(mapping, bytes);
+        return mapping;
+    }
+
+public:
+    StackPool(std::size_t stack_size, bool guarded) :
+        page{static_cast<std::size_t>(sysconf(_SC_PAGESIZE))},
+        size{(std::max<std::size_t>(stack_size, 4096) + page - 1) / page * page},
+        guarded{guarded},
+        mappings{},
+        free{}
+    {}
+
+    StackPool(StackPool const&) = delete;
+    StackPool& operator=(StackPool const&) = delete;
+
+    ~StackPool() noexcept
+    {
+        for (auto const& [mapping, bytes] : mappings) {
+            munmap(mapping, bytes);
+        }
+    }
+
+    // Returns the lowest usable address of a stack of stack_size() bytes.
+    void* allocate()
+    {
+        if (free.empty()) {
+            if (guarded) {
+                auto* const mapping = static_cast<char*>(map(page + size));
+                mprotect(mapping, page, PROT_NONE);
+                free.push_back(mapping + page);
+            } else {
+                auto* const slab = static_cast<char*>(map(slab_stacks * size));
+                for (std::size_t i = 0; i < slab_stacks; ++i) {
+                    free.push_back(slab + i * size);
+                }
+            }
+        }
+        auto* const stack = free.back();
+        free.pop_back();
+        return stack;
+    }
+
+    void release(void* stack)
+    {
+        free.push_back(stack);
+    }
+
+    std::size_t stack_size() const noexcept
+    {
+        return size;
+    }
+};
+
+/*
+ * The thread_locals that scopes set: they belong to the code running on a thread, rather than to the thread,
+ * so fibers sharing a thread each need their own.
+ */
+struct ScopeSlots
+{
+    wait_policy const* waits;
+    cost_model* costs;
+    priority level;
+    tracker* track;
+    executor* exec;
+
+    static ScopeSlots current() noexcept
+    {
+        return {wait_policy_slot(), cost_model_slot(), priority_slot(), tracker_slot(), executor_slot()};
+    }
+
+    void install() const noexcept
+    {
+        wait_policy_slot() = waits;
+        cost_model_slot() = costs;
+        priority_slot() = level;
+        tracker_slot() = track;
+        executor_slot() = exec;
+    }
+};
+
+struct Fiber
+{
+    ucontext_t context;
+    void* stack;
+    ScopeSlots slots;
+    std::function<void()> job;
+    bool (*ready)(void const*);
+    void const* ready_context;
+    bool finished;
+};
+
+/*
+ * One thread of a fiber_executor.  It runs its fibers in turn, and is their suspender:
+ * a fiber that would block is parked on a waiting list, which is polled between runs of the ready fibers,
+ * and whenever the worker is notified that something it waits for may have finished.
+ * A fiber always resumes on the worker that started it, but other fibers run on that thread meanwhile, so it shares
+ * the thread's thread_locals with them.  The exception is what scopes set (see ScopeSlots): each fiber starts with the
+ * worker's, and keeps its own across suspensions.
+ */
+class FiberWorker final : public suspender
+{
+private:
+    // How long a worker with nothing ready sleeps before polling its waiting fibers again, unless notified.
+    // Each poll that wakes nobody doubles it, up to the maximum: waits on work outside the executor are not notified.
+    static constexpr std::chrono::microseconds min_poll_interval{50};
+    static constexpr std::chrono::microseconds max_poll_interval{2000};
+
+    executor* owner;
+    StackPool stacks;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> incoming;
+    bool stopping;
+    bool notified;
+
+    // Whether any fiber is on the waiting list, so that notify() can skip workers with nothing to poll.
+    std::atomic<bool> parked;
+
+    // Only touched by the worker thread.
+    ucontext_t scheduler;
+    Fiber* running;
+    std::deque<Fiber*> ready;
+    std::vector<Fiber*> waiting;
+    std::chrono::microseconds poll_interval;
+
+    std::thread thread;
+
+    static void entry(int high, int low)
+    {
+        auto* const worker = reinterpret_cast<FiberWorker*>(
+            (static_cast<std::uintptr_t>(static_cast<unsigned>(high)) << 32) | static_cast<unsigned>(low));
+        auto* const fiber = worker->running;
+        try {
+            fiber->job();
+        } catch (...) {
+            // Executor jobs must not throw.
+            std::terminate();
+        }
+        fiber->job = nullptr;
+        fiber->finished = true;
+        setcontext(&worker->scheduler);
+    }
+
+    Fiber* make_fiber(std::function<void()> job)
+    {
+        auto fiber = std::make_unique<Fiber>();
+        fiber->stack = stacks.allocate();
+        fiber->slots = ScopeSlots::current();
+        fiber->job = std::move(job);
+        fiber->ready = nullptr;
+        fiber->ready_context = nullptr;
+        fiber->finished = false;
+
+        getcontext(&fiber->context);
+        fiber->context.uc_stack.ss_sp = fiber->stack;
+        fiber->context.uc_stack.ss_size = stacks.stack_size();
+        fiber->context.uc_link = nullptr;
+        auto const self = reinterpret_cast<std::uintptr_t>(this);
+        makecontext(&fiber->context, reinterpret_cast<void (*)()>(&FiberWorker::entry), 2,
+                    static_cast<int>(static_cast<std::uint32_t>(static_cast<std::uint64_t>(self) >> 32)),
+                    static_cast<int>(static_cast<std::uint32_t>(self)));
+        return fiber.release();
+    }
+
+    void switch_to(Fiber* fiber)
+    {
+        running = fiber;
+        auto const worker_slots = ScopeSlots::current();
+        fiber->slots.install();
+        {
+            suspender::scope const scope{this};
+            swapcontext(&scheduler, &fiber->context);
+        }
+        fiber->slots = ScopeSlots::current();
+        worker_slots.install();
+        running = nullptr;
+        if (fiber->finished) {
+            stacks.release(fiber->stack);
+            delete fiber;
+        }
+    }
+
+    void poll()
+    {
+        auto const woken = std::stable_partition(waiting.begin(), waiting.end(), [](Fiber* fiber) {
+            return !fiber->ready(fiber->ready_context);
+        });
+        if (woken != waiting.end()) {
+            poll_interval = min_poll_interval;
+        }
+        for (auto i = woken; i != waiting.end(); ++i) {
+            ready.push_back(*i);
+        }
+        waiting.erase(woken, waiting.end());
+        parked.store(!waiting.empty());
+    }
+
+    void run()
+    {
+        executor::scope const scope{owner};
+        for (;;) {
+            // Poll before sleeping: what a fiber waits for may have finished after it last looked, but before it was
+            // parked, in which case nobody notified this worker.
+            poll();
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                auto const has_work = [this] { return stopping || notified || !incoming.empty(); };
+                if (ready.empty() && waiting.empty()) {
+                    wake.wait(lock, has_work);
+                } else if (ready.empty() && !wake.wait_for(lock, poll_interval, has_work)) {
+                    poll_interval = std::min(2 * poll_interval, max_poll_interval);
+                }
+                notified = false;
+                if (stopping && incoming.empty() && ready.empty() && waiting.empty()) {
+                    return;
+                }
+                for (; !incoming.empty(); incoming.pop_front()) {
+                    ready.push_back(make_fiber(std::move(incoming.front())));
+                }
+            }
+
+            if (ready.empty()) {
+                poll();
+            }
+            // Run only the fibers that are ready now, so that new arrivals and the waiting list are not starved.
+            for (auto n = ready.size(); n > 0; --n) {
+                auto* const fiber = ready.front();
+                ready.pop_front();
+                switch_to(fiber);
+            }
+        }
+    }
+
+protected:
+    void suspend(bool (*is_ready)(void const*), void const* context) override
+    {
+        auto* const fiber = running;
+        fiber->ready = is_ready;
+        fiber->ready_context = context;
+        waiting.push_back(fiber);
+        parked.store(true);
+        swapcontext(&fiber->context, &scheduler);
+    }
+
+public:
+    FiberWorker(executor* owner, std::size_t stack_size, bool guard_pages) :
+        owner{owner},
+        stacks{stack_size, guard_pages},
+        stopping{false},
+        notified{false},
+        parked{false},
+        scheduler{},
+        running{nullptr},
+        poll_interval{min_poll_interval},
+        thread{}
+    {
+        thread = std::thread{[this] { run(); }};
+    }
+
+    FiberWorker(FiberWorker const&) = delete;
+    FiberWorker& operator=(FiberWorker const&) = delete;
+
+    ~FiberWorker() noexcept override
+    {
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    void submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            incoming.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    /*
+     * Tells the worker that something one of its fibers waits for may have finished, so it should poll them.
+     */
+    void notify()
+    {
+        if (!parked.load()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            notified = true;
+        }
+        wake.notify_one();
+    }
+};
+
+}
+
+/*
+ * fiber_executor runs each job on its own user-space fiber, with a small pooled stack, on a fixed set of threads.
+ * When a job waits for a result (e.g. | get() on a shared_task that is running elsewhere, or a parallel when_all),
+ * its fiber is suspended instead of blocking the thread, so the threads stay busy with other fibers.
+ * So the number of jobs that may be blocked at once is limited by memory, not by the number of threads.
+ *
+ * Waits go through the library (see wait_policy); a job that blocks in other ways (e.g. std::future::get,
+ * a mutex or I/O) still blocks its whole thread.  Fibers must not wait inside a catch block.
+ * Suspended fibers are checked when a job on the executor finishes; waits for work elsewhere are also polled.
+ * Linux only.  The destructor waits for every job, including suspended ones, to finish.
+ */
+class fiber_executor : public executor {
+private:
+    std::vector<std::unique_ptr<detail::FiberWorker>> workers;
+    std::atomic<std::size_t> next;
+
+    // Jobs submitted but not yet finished, so that no worker is destroyed while a job might still submit to it.
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::size_t live;
+
+public:
+    /*
+     * Without guard pages, a fiber that overflows its stack corrupts another's, but many more fibers can exist at once.
+     */
+    explicit fiber_executor(std::size_t threads = std::max(1u, std::thread::hardware_concurrency()),
+                            std::size_t stack_size = 64 * 1024,
+                            bool guard_pages = true) :
+        workers{},
+        next{0},
+        live{0}
+    {
+        workers.reserve(std::max<std::size_t>(1, threads));
+        for (std::size_t i = 0; i < std::max<std::size_t>(1, threads); ++i) {
+            workers.push_back(std::make_unique<detail::FiberWorker>(this, stack_size, guard_pages));
+        }
+    }
+
+    fiber_executor(fiber_executor const&) = delete;
+    fiber_executor& operator=(fiber_executor const&) = delete;
+
+    ~fiber_executor() noexcept override
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        idle.wait(lock, [this] { return live == 0; });
+    }
+
+    std::size_t size() const noexcept
+    {
+        return workers.size();
+    }
+
+    using executor::submit;
+
+    /*
+     * Queue a job to be run on a new fiber.  Placement is ignored.
+     * Jobs must not throw.
+     */
+    void submit(std::function<void()> job, placement) override
+    {
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            ++live;
+        }
+        workers[next.fetch_add(1, std::memory_order_relaxed) % workers.size()]->submit([this, job = std::move(job)] {
+            job();
+            // What fibers wait for is mostly other jobs here, so rather than having idle workers poll for it,
+            // wake those with waiting fibers as each job finishes.
+            for (auto& worker : workers) {
+                worker->notify();
+            }
+            std::lock_guard<std::mutex> const lock{mutex};
+            if (--live == 0) {
+                idle.notify_all();
+            }
+        });
+    }
+};
+
+}
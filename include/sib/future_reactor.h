@@ -0,0 +1,207 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sib {
+
+/*
+ * future_reactor calls back when futures become ready, watching any number of them from a single thread, so that
+ * code waiting on futures it did not create does not need a blocked thread for each.
+ *
+ * std::future has no way to notify, so the reactor polls the futures it watches.  It polls again at once after any
+ * become ready, and otherwise backs off, up to max_delay between polls.  When it is watching nothing, it sleeps.
+ *
+ * A source that makes futures ready on a thread of its own (e.g. io_loop) can call notify() afterwards, so that the
+ * reactor polls at once.  Futures found that way do not shorten the backoff, so while the reactor only watches such
+ * sources' futures, its polls stay max_delay apart.
+ */
+class future_reactor
+{
+private:
+    struct Watch
+    {
+        virtual ~Watch() = default;
+        virtual bool ready() const = 0;
+        virtual void fire() = 0;
+    };
+
+    template<typename Future, typename Callback>
+    struct Watching final : Watch
+    {
+        Future future;
+        Callback callback;
+
+        Watching(Future future, Callback callback) :
+            future{std::move(future)},
+            callback{std::move(callback)}
+        {}
+
+        bool ready() const override
+        {
+            return future.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+        }
+
+        void fire() override
+        {
+            std::move(callback)(std::move(future));
+        }
+    };
+
+    std::chrono::microseconds min_delay;
+    std::chrono::microseconds max_delay;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<std::unique_ptr<Watch>> incoming;
+    std::size_t watched;
+    bool notified;
+    bool stopping;
+    std::thread thread;
+
+    void run()
+    {
+        std::vector<std::unique_ptr<Watch>> watching;
+        auto delay = min_delay;
+        for (;;) {
+            auto timed_out = false;
+            auto was_notified = false;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                auto const has_work = [this] { return stopping || notified || !incoming.empty(); };
+                if (watching.empty()) {
+                    wake.wait(lock, has_work);
+                } else {
+                    timed_out = !wake.wait_for(lock, delay, has_work);
+                }
+                was_notified = std::exchange(notified, false);
+                if (stopping) {
+                    // Abandoned callbacks are destroyed unrun; promises they hold report broken_promise.
+                    return;
+                }
+                std::move(incoming.begin(), incoming.end(), std::back_inserter(watching));
+                incoming.clear();
+            }
+
+            auto const woken = std::stable_partition(watching.begin(), watching.end(), [](auto const& watch) {
+                return !watch->ready();
+            });
+            std::vector<std::unique_ptr<Watch>> fired;
+            std::move(woken, watching.end(), std::back_inserter(fired));
+            watching.erase(woken, watching.end());
+            for (auto& watch : fired) {
+                try {
+                    watch->fire();
+                } catch (...) {
+                    // Callbacks must not throw.
+                    std::terminate();
+                }
+            }
+            {
+                std::lock_guard<std::mutex> const lock{mutex};
+                watched -= fired.size();
+            }
+            if (fired.empty()) {
+                if (timed_out) {
+                    delay = std::min(delay * 2, max_delay);
+                }
+            } else if (!was_notified) {
+                delay = min_delay;
+            }
+        }
+    }
+
+public:
+    explicit future_reactor(std::chrono::microseconds min_delay = std::chrono::microseconds{10},
+                            std::chrono::microseconds max_delay = std::chrono::microseconds{1000}) :
+        min_delay{std::max(std::chrono::microseconds{1}, min_delay)},
+        max_delay{std::max(this->min_delay, max_delay)},
+        watched{0},
+        notified{false},
+        stopping{false}
+    {
+        thread = std::thread{[this] { run(); }};
+    }
+
+    future_reactor(future_reactor const&) = delete;
+    future_reactor& operator=(future_reactor const&) = delete;
+
+    ~future_reactor() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    /*
+     * Calls callback(std::move(future)) once future is ready: at once on this thread if it is ready already, and
+     * otherwise on the reactor's thread, which should not be kept busy.  Callbacks must not throw.
+     */
+    template<typename Future, typename Callback>
+    void when_ready(Future future, Callback callback)
+    {
+        if (future.wait_for(std::chrono::seconds{0}) == std::future_status::ready) {
+            std::move(callback)(std::move(future));
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            incoming.push_back(std::make_unique<Watching<Future, Callback>>(std::move(future), std::move(callback)));
+            ++watched;
+        }
+        wake.notify_one();
+    }
+
+    /*
+     * Tells the reactor that futures it watches may have become ready, so that it polls them at once rather than
+     * after its backoff.
+     */
+    void notify()
+    {
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            if (watched == 0) {
+                return;
+            }
+            notified = true;
+        }
+        wake.notify_one();
+    }
+
+    /*
+     * The number of futures being watched.
+     */
+    std::size_t size()
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        return watched;
+    }
+
+    /*
+     * The reactor shared by default.
+     */
+    static future_reactor& global()
+    {
+        static future_reactor reactor;
+        return reactor;
+    }
+};
+
+}
@@ -0,0 +1,450 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/future_reactor.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace sib {
+
+/*
+ * io_loop turns reads, writes, accepts and timers into std::futures, which complete from a single epoll thread.
+ * So any number of outstanding I/O waits cost no threads, and (with sib/monad/future.h) compose with then, ^ and &.
+ * After completing any, the loop notifies a future_reactor (by default the global one, which future.h uses), so
+ * that composed futures are picked up at once rather than at the reactor's next poll.
+ *
+ * Each operation is tried at once, and only waits for readiness if the fd would block, so fds must be non-blocking.
+ * Buffers must outlive their operations.  Operations on one fd, in one direction, complete in the order they started.
+ * An operation that fails sets its future's exception to a std::system_error.  Linux only.
+ * Writing to a socket or pipe whose reader has gone fails with EPIPE, rather than raising SIGPIPE.
+ */
+class io_loop
+{
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Operation
+    {
+        // Returns false if the operation would block.
+        std::function<bool()> attempt;
+        // Fulfils the promise with the outcome of the attempt that did not block.
+        std::function<void()> complete;
+        std::function<void(std::exception_ptr)> abandon;
+    };
+
+    struct Watched
+    {
+        std::deque<Operation> readers;
+        std::deque<Operation> writers;
+        bool registered = false;
+    };
+
+    future_reactor* reactor;
+    int epoll;
+    int wake;
+    int timer;
+
+    mutable std::mutex mutex;
+    std::unordered_map<int, Watched> watched;
+    std::multimap<clock::time_point, std::shared_ptr<std::promise<void>>> timers;
+    bool stopping;
+    std::thread thread;
+
+    [[noreturn]] static void fail(char const* what)
+    {
+        throw std::system_error{errno, std::generic_category(), what};
+    }
+
+    static std::exception_ptr error(int code, char const* what)
+    {
+        return std::make_exception_ptr(std::system_error{code, std::generic_category(), what});
+    }
+
+    // An operation that calls call() until it stops failing with EAGAIN or EINTR.
+    template<typename R, typename Call>
+    static Operation operation(std::shared_ptr<std::promise<R>> promise, Call call, char const* what)
+    {
+        struct Outcome
+        {
+            long result = -1;
+            int error = 0;
+        };
+        auto const outcome = std::make_shared<Outcome>();
+        auto attempt = [outcome, call = std::move(call)] {
+            for (;;) {
+                auto const result = call();
+                if (result >= 0) {
+                    outcome->result = static_cast<long>(result);
+                    return true;
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return false;
+                }
+                outcome->error = errno;
+                return true;
+            }
+        };
+        auto complete = [outcome, promise, what] {
+            if (outcome->error != 0) {
+                promise->set_exception(error(outcome->error, what));
+            } else {
+                promise->set_value(static_cast<R>(outcome->result));
+            }
+        };
+        auto abandon = [promise](std::exception_ptr reason) { promise->set_exception(std::move(reason)); };
+        return {std::move(attempt), std::move(complete), std::move(abandon)};
+    }
+
+    // Writes to fd without raising SIGPIPE if its reader has gone, so that EPIPE reaches the future instead.
+    static ssize_t write_quietly(int fd, void const* buffer, std::size_t size)
+    {
+        auto const sent = ::send(fd, buffer, size, MSG_NOSIGNAL);
+        if (sent >= 0 || errno != ENOTSOCK) {
+            return sent;
+        }
+
+        // Not a socket (e.g. a pipe), so block SIGPIPE on this thread while writing, and consume any the write raised.
+        // One that was already pending is left for its owner.
+        sigset_t pipe;
+        sigset_t previous;
+        sigset_t pending;
+        ::sigemptyset(&pipe);
+        ::sigaddset(&pipe, SIGPIPE);
+        ::pthread_sigmask(SIG_BLOCK, &pipe, &previous);
+        ::sigpending(&pending);
+        auto const was_pending = ::sigismember(&pending, SIGPIPE) == 1;
+
+        auto const written = ::write(fd, buffer, size);
+        auto const code = errno;
+        if (written < 0 && code == EPIPE && !was_pending) {
+            timespec const now{0, 0};
+            while (::sigtimedwait(&pipe, nullptr, &now) < 0 && errno == EINTR) {
+            }
+        }
+        ::pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+        errno = code;
+        return written;
+    }
+
+    static void abandon(std::deque<Operation>& queue, char const* what)
+    {
+        for (auto& op : queue) {
+            op.abandon(error(ECANCELED, what));
+        }
+        queue.clear();
+    }
+
+    // Runs the attempts at the front of queue until one would block, moving those that did not to done.
+    // Call with the mutex held.
+    static void drain(std::deque<Operation>& queue, std::vector<Operation>& done)
+    {
+        while (!queue.empty() && queue.front().attempt()) {
+            done.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+    }
+
+    // Registers the fd for the directions that have operations waiting, or unregisters it.  Call with the mutex held.
+    void arm(int fd)
+    {
+        auto const found = watched.find(fd);
+        auto& entry = found->second;
+        std::uint32_t const events = (entry.readers.empty() ? 0u : std::uint32_t{EPOLLIN}) |
+                                     (entry.writers.empty() ? 0u : std::uint32_t{EPOLLOUT});
+        if (events == 0) {
+            if (entry.registered) {
+                ::epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+            }
+            watched.erase(found);
+            return;
+        }
+        epoll_event event{};
+        event.events = events | EPOLLONESHOT;
+        event.data.fd = fd;
+        if (::epoll_ctl(epoll, entry.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0) {
+            // e.g. a regular file, which epoll cannot watch.
+            auto const reason = error(errno, "io_loop: epoll_ctl");
+            for (auto* queue : {&entry.readers, &entry.writers}) {
+                for (auto& op : *queue) {
+                    op.abandon(reason);
+                }
+            }
+            watched.erase(found);
+            return;
+        }
+        entry.registered = true;
+    }
+
+    template<typename R, typename Call>
+    std::future<R> start(int fd, bool write, Call call, char const* what)
+    {
+        auto promise = std::make_shared<std::promise<R>>();
+        auto result = promise->get_future();
+        auto op = operation(std::move(promise), std::move(call), what);
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            auto& entry = watched[fd];
+            auto& queue = write ? entry.writers : entry.readers;
+            // Only try at once if no earlier operation is waiting, so that they stay in order.
+            auto const waiting = !queue.empty() || !op.attempt();
+            if (waiting) {
+                queue.push_back(std::move(op));
+            }
+            arm(fd);
+            if (waiting) {
+                return result;
+            }
+        }
+        op.complete();
+        return result;
+    }
+
+    // Sets the timerfd to the earliest deadline.  Call with the mutex held.
+    void reset_timer()
+    {
+        itimerspec spec{};
+        if (!timers.empty()) {
+            auto const since = std::chrono::duration_cast<std::chrono::nanoseconds>(timers.begin()->first.time_since_epoch());
+            // Zero would disarm the timer.
+            auto const at = std::max(since, std::chrono::nanoseconds{1});
+            spec.it_value.tv_sec = static_cast<time_t>(at.count() / 1000000000);
+            spec.it_value.tv_nsec = static_cast<long>(at.count() % 1000000000);
+        }
+        ::timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+
+    void run()
+    {
+        epoll_event events[64];
+        std::vector<Operation> done;
+        std::vector<std::shared_ptr<std::promise<void>>> expired;
+        for (;;) {
+            auto const n = ::epoll_wait(epoll, events, 64, -1);
+            std::unique_lock<std::mutex> lock{mutex};
+            if (stopping) {
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                auto const fd = events[i].data.fd;
+                if (fd == wake) {
+                    std::uint64_t count;
+                    [[maybe_unused]] auto const ignored = ::read(wake, &count, sizeof(count));
+                } else if (fd == timer) {
+                    std::uint64_t count;
+                    [[maybe_unused]] auto const ignored = ::read(timer, &count, sizeof(count));
+                    auto const now = clock::now();
+                    while (!timers.empty() && timers.begin()->first <= now) {
+                        expired.push_back(std::move(timers.begin()->second));
+                        timers.erase(timers.begin());
+                    }
+                    reset_timer();
+                } else if (auto const found = watched.find(fd); found != watched.end()) {
+                    // On an error or hang-up, let the operations find out for themselves.
+                    if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                        drain(found->second.readers, done);
+                    }
+                    if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                        drain(found->second.writers, done);
+                    }
+                    arm(fd);
+                }
+            }
+            lock.unlock();
+
+            // Complete operations only once the loop has finished with their fds, which their owners may then close.
+            for (auto& op : done) {
+                op.complete();
+            }
+            for (auto& promise : expired) {
+                promise->set_value();
+            }
+            if (!done.empty() || !expired.empty()) {
+                reactor->notify();
+            }
+            done.clear();
+            expired.clear();
+        }
+    }
+
+    void add(int fd)
+    {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (::epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            fail("io_loop: epoll_ctl");
+        }
+    }
+
+public:
+    /*
+     * reactor is notified whenever operations complete, and must outlive the loop.
+     * Throws std::system_error if the loop's own fds cannot be created.
+     */
+    explicit io_loop(future_reactor& reactor = future_reactor::global()) :
+        reactor{&reactor},
+        epoll{-1},
+        wake{-1},
+        timer{-1},
+        stopping{false}
+    {
+        try {
+            if ((epoll = ::epoll_create1(EPOLL_CLOEXEC)) < 0) {
+                fail("io_loop: epoll_create1");
+            }
+            if ((wake = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+                fail("io_loop: eventfd");
+            }
+            if ((timer = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+                fail("io_loop: timerfd_create");
+            }
+            add(wake);
+            add(timer);
+        } catch (...) {
+            for (auto const fd : {epoll, wake, timer}) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+            throw;
+        }
+        thread = std::thread{[this] { run(); }};
+    }
+
+    io_loop(io_loop const&) = delete;
+    io_loop& operator=(io_loop const&) = delete;
+
+    /*
+     * Operations still waiting fail with ECANCELED.
+     */
+    ~io_loop() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            stopping = true;
+        }
+        std::uint64_t const one = 1;
+        [[maybe_unused]] auto const ignored = ::write(wake, &one, sizeof(one));
+        thread.join();
+
+        for (auto& [fd, entry] : watched) {
+            abandon(entry.readers, "io_loop: destroyed");
+            abandon(entry.writers, "io_loop: destroyed");
+        }
+        for (auto const& [deadline, promise] : timers) {
+            promise->set_exception(error(ECANCELED, "io_loop: destroyed"));
+        }
+        ::close(timer);
+        ::close(wake);
+        ::close(epoll);
+    }
+
+    /*
+     * Reads up to size bytes from fd into buffer, once there are any to read.  The result is the number read, or 0 at
+     * end of file.
+     */
+    std::future<std::size_t> read(int fd, void* buffer, std::size_t size)
+    {
+        return start<std::size_t>(fd, false, [=] { return ::read(fd, buffer, size); }, "io_loop: read");
+    }
+
+    /*
+     * Writes up to size bytes from buffer to fd, once it can take any.  The result is the number written.
+     */
+    std::future<std::size_t> write(int fd, void const* buffer, std::size_t size)
+    {
+        return start<std::size_t>(fd, true, [=] { return write_quietly(fd, buffer, size); }, "io_loop: write");
+    }
+
+    /*
+     * Accepts a connection on the listening socket fd.  The result is the new socket, which is non-blocking.
+     */
+    std::future<int> accept(int fd)
+    {
+        return start<int>(fd, false, [=] {
+            return ::accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        }, "io_loop: accept");
+    }
+
+    /*
+     * Becomes ready once delay has passed.
+     */
+    std::future<void> after(clock::duration delay)
+    {
+        auto promise = std::make_shared<std::promise<void>>();
+        auto result = promise->get_future();
+        std::lock_guard<std::mutex> const lock{mutex};
+        auto const entry = timers.emplace(clock::now() + delay, std::move(promise));
+        if (entry == timers.begin()) {
+            reset_timer();
+        }
+        return result;
+    }
+
+    /*
+     * Fails every operation waiting on fd with ECANCELED, e.g. before closing it.
+     */
+    void cancel(int fd)
+    {
+        std::deque<Operation> cancelled;
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            if (auto const found = watched.find(fd); found != watched.end()) {
+                cancelled = std::move(found->second.readers);
+                std::move(found->second.writers.begin(), found->second.writers.end(), std::back_inserter(cancelled));
+                found->second.readers.clear();
+                found->second.writers.clear();
+                arm(fd);
+            }
+        }
+        if (!cancelled.empty()) {
+            abandon(cancelled, "io_loop: cancelled");
+            reactor->notify();
+        }
+    }
+
+    /*
+     * The number of operations (including timers) waiting.
+     */
+    std::size_t pending() const
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        auto count = timers.size();
+        for (auto const& [fd, entry] : watched) {
+            count += entry.readers.size() + entry.writers.size();
+        }
+        return count;
+    }
+};
+
+}
@@ -0,0 +1,200 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/monad/monad.h"
+#include "sib/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace sib::monad {
+
+/*
+ * GetBatch is Get for many sets of arguments at once.
+ * Each element of range is either a Get (e.g. get(1, 2)) or a std::tuple of arguments, and range must be random-access.
+ *
+ * With no pool, the elements are evaluated in order on the calling thread.
+ * Otherwise, they are split into chunks that are evaluated across the pool's workers and the calling thread.
+ */
+template<typename Range>
+struct GetBatch
+{
+    thread_pool* pool;
+    Range range;
+};
+static inline constexpr struct {
+    template<typename Range>
+    GetBatch<Range> operator()(Range&& range) const
+    {
+        return {nullptr, std::forward<Range>(range)};
+    }
+
+    template<typename Range>
+    GetBatch<Range> operator()(in manner, Range&& range) const
+    {
+        return {manner == in::parallel ? &default_thread_pool() : nullptr, std::forward<Range>(range)};
+    }
+
+    template<typename Range>
+    GetBatch<Range> operator()(thread_pool& pool, Range&& range) const
+    {
+        return {&pool, std::forward<Range>(range)};
+    }
+} get_batch;
+
+namespace detail {
+
+template<typename... Args>
+std::tuple<Args...> const& batch_args(Get<Args...> const& g)
+{
+    return g.args;
+}
+
+template<typename... Args>
+std::tuple<Args...> const& batch_args(std::tuple<Args...> const& args)
+{
+    return args;
+}
+
+struct BatchState
+{
+    std::size_t chunks;
+    std::atomic<std::size_t> next{0};
+    std::size_t finished = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+
+    explicit BatchState(std::size_t chunks) :
+        chunks{chunks}
+    {}
+
+    // Claims and runs chunks until there are none left.
+    template<typename RunChunk>
+    void work(RunChunk const& run_chunk)
+    {
+        for (auto chunk = next++; chunk < chunks; chunk = next++) {
+            std::exception_ptr exception;
+            try {
+                run_chunk(chunk);
+            } catch (...) {
+                exception = std::current_exception();
+            }
+            std::lock_guard<std::mutex> const lock{mutex};
+            if (exception && !error) {
+                error = exception;
+            }
+            if (++finished == chunks) {
+                done.notify_all();
+            }
+        }
+    }
+};
+
+// Runs invoke(begin, end, chunk) over [0, size) in chunks, across the pool's workers and the calling thread.
+template<typename Invoke>
+void run_chunks(thread_pool& pool, std::size_t size, std::size_t chunk_size, Invoke const& invoke)
+{
+    auto const run_chunk = [&](std::size_t chunk) {
+        invoke(chunk * chunk_size, std::min(size, (chunk + 1) * chunk_size), chunk);
+    };
+
+    // Workers only touch the caller's stack once they have claimed a chunk, and the caller waits for every chunk.
+    // So a worker that starts after all the chunks have been claimed touches nothing but the shared state.
+    auto const state = std::make_shared<BatchState>((size + chunk_size - 1) / chunk_size);
+    for (std::size_t i = 0; i < pool.size() && i + 1 < state->chunks; ++i) {
+        pool.submit([state, &run_chunk] { state->work(run_chunk); });
+    }
+    // The calling thread works too, so that a batch makes progress even if every worker is busy.
+    state->work(run_chunk);
+
+    std::unique_lock<std::mutex> lock{state->mutex};
+    state->done.wait(lock, [&state] { return state->finished == state->chunks; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+/*
+ * Invokes callable on each element's arguments, writing the results to a contiguous std::vector.
+ * callable is invoked directly: nothing is wrapped per element.
+ *
+ * In parallel, a default-constructible R is written straight into the pre-sized vector, each element by one thread.
+ * Other results (including bool, whose packed bits several threads would otherwise share) are constructed in place
+ * in uninitialised storage, and then moved into the vector in order.
+ */
+template<typename R, typename Callable, typename Range>
+std::vector<R> run_batch(Callable const& callable, GetBatch<Range> const& batch)
+{
+    static_assert(!std::is_void_v<R>, "get_batch collects each call's result, so the function cannot return void");
+
+    auto const first = std::begin(batch.range);
+    auto const size = static_cast<std::size_t>(std::distance(first, std::end(batch.range)));
+
+    if (!batch.pool || size < 2) {
+        std::vector<R> results;
+        results.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            results.push_back(std::apply(callable, batch_args(first[i])));
+        }
+        return results;
+    }
+
+    // A few chunks per worker, so that uneven chunks balance out.
+    auto const chunks = std::min(size, 4 * (batch.pool->size() + 1));
+    auto const chunk_size = (size + chunks - 1) / chunks;
+
+    if constexpr (std::is_default_constructible_v<R> && !std::is_same_v<R, bool>) {
+        std::vector<R> results(size);
+        run_chunks(*batch.pool, size, chunk_size, [&](std::size_t begin, std::size_t end, std::size_t) {
+            for (auto i = begin; i < end; ++i) {
+                results[i] = std::apply(callable, batch_args(first[i]));
+            }
+        });
+        return results;
+    } else {
+        // Each chunk counts the results it has constructed, so that only those are destroyed.
+        std::allocator<R> allocator;
+        R* const storage = allocator.allocate(size);
+        std::vector<std::size_t> constructed((size + chunk_size - 1) / chunk_size);
+        auto const release = [&] {
+            for (std::size_t chunk = 0; chunk < constructed.size(); ++chunk) {
+                std::destroy_n(storage + chunk * chunk_size, constructed[chunk]);
+            }
+            allocator.deallocate(storage, size);
+        };
+
+        try {
+            run_chunks(*batch.pool, size, chunk_size, [&](std::size_t begin, std::size_t end, std::size_t chunk) {
+                for (auto i = begin; i < end; ++i) {
+                    ::new (static_cast<void*>(storage + i)) R(std::apply(callable, batch_args(first[i])));
+                    ++constructed[chunk];
+                }
+            });
+
+            std::vector<R> results;
+            results.reserve(size);
+            std::move(storage, storage + size, std::back_inserter(results));
+            release();
+            return results;
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+}
+
+}
+
+}
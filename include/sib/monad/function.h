@@ -5,8 +5,11 @@
 
 #pragma once
 
+#include "sib/monad/batch.h"
 #include "sib/monad/task.h"
 #include <functional>
+#include <tuple>
+#include <utility>
 
 namespace sib::monad {
 
@@ -22,6 +25,12 @@ R operator|(std::function<R(Args...)> const& function, Get<GArgs...> const& g)
     return std::apply(function, g.args);
 }
 
+template<typename R, typename... Args, typename Range>
+std::vector<R> operator|(std::function<R(Args...)> const& function, GetBatch<Range> const& batch)
+{
+    return detail::run_batch<R>(function, batch);
+}
+
 template<typename Signature>
 std::function<Signature> operator|(std::function<Signature> function, Flatten)
 {
@@ -73,4 +82,43 @@ When<std::function<std::tuple<Ls..., R>(LArgs..., RArgs...)>>
     return lhs.manner ^ std::move(lambda);
 }
 
+namespace detail {
+
+template<typename Signature, typename Indices, typename... Signatures>
+class AllOfFunctions;
+
+template<typename Tuple, typename... Args, std::size_t... Is, typename... Signatures>
+class AllOfFunctions<Tuple(Args...), std::index_sequence<Is...>, Signatures...>
+{
+public:
+    static std::function<Tuple(Args...)> make(in manner, std::function<Signatures>... functions)
+    {
+        return [manner, functions = std::make_tuple(std::move(functions)...)](Args... args) {
+            auto task = WhenAll<std::packaged_task<Signatures>...>::combine(
+                manner, std::packaged_task<Signatures>{std::get<Is>(functions)}...);
+            auto future = task.get_future();
+            task(std::forward<Args>(args)...);
+            return future.get();
+        };
+    }
+};
+
+}
+
+/*
+ * when_all over std::functions makes one function that, on each call, runs them all through when_all over tasks,
+ * rather than nesting a function for each operator&.
+ */
+template<typename... Signatures>
+struct WhenAll<std::function<Signatures>...>
+{
+    using Signature = detail::all_of_signature_t<Signatures...>;
+
+    static std::function<Signature> combine(in manner, std::function<Signatures>... functions)
+    {
+        return detail::AllOfFunctions<Signature, std::index_sequence_for<Signatures...>, Signatures...>::make(
+            manner, std::move(functions)...);
+    }
+};
+
 }
@@ -0,0 +1,282 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/monad/monad.h"
+#include "sib/executor.h"
+#include "sib/future_reactor.h"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+ * std::future and std::shared_future as monads.
+ * The futures are already running, so then, ^ and & do not block a thread: they return new futures, fulfilled by
+ * callbacks from the global future_reactor.
+ * A continuation runs on the executor that was current when then was called, or else on the reactor's thread.
+ * That executor is held by pointer, so must outlive every continuation queued for it, even one whose future never
+ * becomes ready before the executor is destroyed.
+ */
+namespace sib::monad {
+
+namespace detail {
+
+template<typename T>
+struct IsFuture : std::false_type {};
+
+template<typename R>
+struct IsFuture<std::future<R>> : std::true_type {};
+
+template<typename R>
+struct IsFuture<std::shared_future<R>> : std::true_type {};
+
+template<typename T>
+static inline constexpr bool is_future_v = IsFuture<T>::value;
+
+template<typename Future>
+using future_value_t = std::decay_t<decltype(std::declval<Future&>().get())>;
+
+// Sets promise from the result of f(), or the exception it throws.
+template<typename R, typename Invocable>
+void fulfil(std::promise<R>& promise, Invocable&& f)
+{
+    try {
+        if constexpr (std::is_void_v<R>) {
+            std::forward<Invocable>(f)();
+            promise.set_value();
+        } else {
+            promise.set_value(std::forward<Invocable>(f)());
+        }
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+}
+
+template<typename Invocable, typename Future>
+decltype(auto) invoke_on(Invocable& f, Future& future)
+{
+    if constexpr (std::is_void_v<future_value_t<Future>>) {
+        future.get();
+        return f();
+    } else {
+        return f(future.get());
+    }
+}
+
+template<typename Invocable, typename Future>
+struct ThenResult
+{
+    using type = std::invoke_result_t<Invocable, future_value_t<Future>>;
+};
+
+template<typename Invocable>
+struct ThenResult<Invocable, std::future<void>>
+{
+    using type = std::invoke_result_t<Invocable>;
+};
+
+template<typename Invocable>
+struct ThenResult<Invocable, std::shared_future<void>>
+{
+    using type = std::invoke_result_t<Invocable>;
+};
+
+template<typename Future, typename Invocable>
+auto then_future(Future future, Invocable f)
+{
+    using Result = typename ThenResult<Invocable, Future>::type;
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto result = promise->get_future();
+    // Executors are not reference-counted, so exec must outlive the continuation (see above).
+    future_reactor::global().when_ready(std::move(future),
+            [promise, f = std::move(f), exec = executor::current()](Future ready) mutable {
+        auto continuation = [promise, f = std::move(f), ready = std::move(ready)]() mutable {
+            fulfil(*promise, [&f, &ready]() -> Result { return invoke_on(f, ready); });
+        };
+        if (exec) {
+            // Executors take copyable jobs.
+            exec->submit([job = std::make_shared<decltype(continuation)>(std::move(continuation))] { (*job)(); });
+        } else {
+            continuation();
+        }
+    });
+    return result;
+}
+
+template<typename Outer>
+auto flatten_future(Outer outer)
+{
+    using Inner = future_value_t<Outer>;
+    using R = future_value_t<Inner>;
+    auto promise = std::make_shared<std::promise<R>>();
+    auto result = promise->get_future();
+    future_reactor::global().when_ready(std::move(outer), [promise](Outer ready) {
+        Inner inner;
+        try {
+            inner = ready.get();
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+            return;
+        }
+        future_reactor::global().when_ready(std::move(inner), [promise](Inner ready) {
+            fulfil(*promise, [&ready]() -> R { return ready.get(); });
+        });
+    });
+    return result;
+}
+
+// In sequence, the result is lhs's unless that fails; in parallel, it is whichever succeeds first.
+template<typename R, typename L, typename Rhs>
+std::future<R> any_of(in manner, L lhs, Rhs rhs)
+{
+    auto promise = std::make_shared<std::promise<R>>();
+    auto result = promise->get_future();
+    if (manner != in::parallel) {
+        future_reactor::global().when_ready(std::move(lhs), [promise, rhs = std::move(rhs)](L ready) mutable {
+            try {
+                if constexpr (std::is_void_v<R>) {
+                    ready.get();
+                    promise->set_value();
+                } else {
+                    promise->set_value(ready.get());
+                }
+            } catch (...) {
+                future_reactor::global().when_ready(std::move(rhs), [promise](Rhs ready) {
+                    fulfil(*promise, [&ready]() -> R { return ready.get(); });
+                });
+            }
+        });
+        return result;
+    }
+
+    struct Race
+    {
+        std::mutex mutex;
+        int remaining = 2;
+        bool done = false;
+    };
+    auto const race = std::make_shared<Race>();
+    auto const finish = [race, promise](auto ready) {
+        try {
+            if constexpr (std::is_void_v<R>) {
+                ready.get();
+                std::lock_guard<std::mutex> const lock{race->mutex};
+                if (!std::exchange(race->done, true)) {
+                    promise->set_value();
+                }
+            } else {
+                auto value = ready.get();
+                std::lock_guard<std::mutex> const lock{race->mutex};
+                if (!std::exchange(race->done, true)) {
+                    promise->set_value(std::move(value));
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> const lock{race->mutex};
+            if (--race->remaining == 0 && !std::exchange(race->done, true)) {
+                promise->set_exception(std::current_exception());
+            }
+        }
+    };
+    future_reactor::global().when_ready(std::move(lhs), finish);
+    future_reactor::global().when_ready(std::move(rhs), finish);
+    return result;
+}
+
+template<typename Tuple, typename L, typename Rhs>
+std::future<Tuple> all_of(L lhs, Rhs rhs)
+{
+    auto promise = std::make_shared<std::promise<Tuple>>();
+    auto result = promise->get_future();
+    future_reactor::global().when_ready(std::move(lhs), [promise, rhs = std::move(rhs)](L lready) mutable {
+        future_reactor::global().when_ready(std::move(rhs), [promise, lready = std::move(lready)](Rhs rready) mutable {
+            fulfil(*promise, [&lready, &rready]() -> Tuple {
+                auto lresult = lready.get();
+                return std::tuple_cat(std::move(lresult), std::make_tuple(rready.get()));
+            });
+        });
+    });
+    return result;
+}
+
+}
+
+template<typename R>
+R operator|(std::future<R> future, Get<>)
+{
+    current_wait_policy().wait(future);
+    return future.get();
+}
+
+template<typename R>
+R operator|(std::shared_future<R> const& future, Get<>)
+{
+    current_wait_policy().wait(future);
+    return future.get();
+}
+
+template<typename R>
+std::future<R> operator|(std::future<R> future, Flatten)
+{
+    return future;
+}
+
+template<typename R>
+std::shared_future<R> operator|(std::shared_future<R> future, Flatten)
+{
+    return future;
+}
+
+template<typename R>
+std::future<R> operator|(std::future<std::future<R>> future, Flatten)
+{
+    return detail::flatten_future(std::move(future));
+}
+
+template<typename R>
+std::future<R> operator|(std::future<std::shared_future<R>> future, Flatten)
+{
+    return detail::flatten_future(std::move(future));
+}
+
+template<typename R>
+std::future<R> operator|(std::shared_future<std::shared_future<R>> future, Flatten)
+{
+    return detail::flatten_future(std::move(future));
+}
+
+template<typename R, typename Invocable>
+auto operator|(std::future<R> future, Then<Invocable> f)
+{
+    return detail::then_future(std::move(future), std::move(f)) | flatten();
+}
+
+template<typename R, typename Invocable>
+auto operator|(std::shared_future<R> future, Then<Invocable> f)
+{
+    return detail::then_future(std::move(future), std::move(f)) | flatten();
+}
+
+template<typename L, typename Rhs, typename = std::enable_if_t<detail::is_future_v<L> && detail::is_future_v<Rhs>>>
+When<std::future<detail::future_value_t<L>>> operator^(When<L> lhs, Rhs rhs)
+{
+    using R = detail::future_value_t<L>;
+    static_assert(std::is_same_v<R, detail::future_value_t<Rhs>>, "when_any needs futures of the same type");
+    return {lhs.manner, detail::any_of<R>(lhs.manner, std::move(lhs.value), std::move(rhs))};
+}
+
+template<typename L, typename Rhs, typename = std::enable_if_t<detail::is_future_v<L> && detail::is_future_v<Rhs>>>
+auto operator&(When<L> lhs, Rhs rhs)
+{
+    using Tuple = decltype(std::tuple_cat(std::declval<detail::future_value_t<L>>(),
+                                          std::make_tuple(std::declval<detail::future_value_t<Rhs>>())));
+    return When<std::future<Tuple>>{lhs.manner, detail::all_of<Tuple>(std::move(lhs.value), std::move(rhs))};
+}
+
+}
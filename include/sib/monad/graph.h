@@ -0,0 +1,318 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/monad/monad.h"
+#include "sib/thread_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace sib::monad {
+
+namespace detail {
+
+struct GraphNode
+{
+    std::size_t in_degree = 0;
+    std::atomic<std::size_t> pending{0};
+    std::vector<GraphNode*> successors;
+
+    virtual ~GraphNode() = default;
+
+    virtual void reset() noexcept
+    {
+        pending.store(in_degree, std::memory_order_relaxed);
+    }
+
+    // Called by each predecessor once it has run.  Returns true if this node has just become ready to run.
+    virtual bool release(GraphNode const&) noexcept
+    {
+        return pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    virtual bool succeeded() const noexcept = 0;
+    virtual void run() noexcept = 0;
+};
+
+template<typename T>
+struct ValueNode : GraphNode
+{
+    std::optional<T> value;
+    std::exception_ptr error;
+
+    void reset() noexcept override
+    {
+        GraphNode::reset();
+        value.reset();
+        error = nullptr;
+    }
+
+    bool succeeded() const noexcept override
+    {
+        return value.has_value();
+    }
+
+    T const& get() const
+    {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return value.value();
+    }
+};
+
+template<typename T, typename Body>
+struct BodyNode : ValueNode<T>
+{
+    Body body;
+
+    explicit BodyNode(Body body) :
+        body{std::move(body)}
+    {}
+
+    void run() noexcept override
+    {
+        try {
+            this->value.emplace(body());
+        } catch (...) {
+            this->error = std::current_exception();
+        }
+    }
+};
+
+// Becomes ready as soon as any predecessor succeeds, or once they have all failed.
+template<typename T>
+struct AnyNode : ValueNode<T>
+{
+    std::atomic<bool> fired{false};
+    ValueNode<T> const* winner = nullptr;
+
+    void reset() noexcept override
+    {
+        ValueNode<T>::reset();
+        fired.store(false, std::memory_order_relaxed);
+        winner = nullptr;
+    }
+
+    bool release(GraphNode const& predecessor) noexcept override
+    {
+        auto const last = this->pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        if ((predecessor.succeeded() || last) && !fired.exchange(true, std::memory_order_acq_rel)) {
+            winner = static_cast<ValueNode<T> const*>(&predecessor);
+            return true;
+        }
+        return false;
+    }
+
+    void run() noexcept override
+    {
+        try {
+            this->value.emplace(winner->get());
+        } catch (...) {
+            this->error = std::current_exception();
+        }
+    }
+};
+
+struct GraphState
+{
+    std::vector<std::unique_ptr<GraphNode>> nodes;
+    std::atomic<std::size_t> remaining{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+
+    template<typename Node>
+    Node* add(std::unique_ptr<Node> node, std::initializer_list<GraphNode*> predecessors)
+    {
+        auto* result = node.get();
+        for (auto* predecessor : predecessors) {
+            predecessor->successors.push_back(result);
+            ++result->in_degree;
+        }
+        nodes.push_back(std::move(node));
+        return result;
+    }
+
+    // Runs node, then releases its successors.
+    // The first successor to become ready runs next on this worker; any others are submitted to the pool.
+    void execute(GraphNode* node, thread_pool& pool)
+    {
+        while (node) {
+            node->run();
+            GraphNode* next = nullptr;
+            for (auto* successor : node->successors) {
+                if (successor->release(*node)) {
+                    if (!next) {
+                        next = successor;
+                    } else {
+                        pool.submit([this, successor, &pool] { execute(successor, pool); });
+                    }
+                }
+            }
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> const lock{mutex};
+                done = true;
+                finished.notify_all();
+            }
+            node = next;
+        }
+    }
+
+    void run(thread_pool& pool)
+    {
+        if (nodes.empty()) {
+            return;
+        }
+        for (auto& node : nodes) {
+            node->reset();
+        }
+        remaining.store(nodes.size(), std::memory_order_relaxed);
+        done = false;
+
+        for (auto& node : nodes) {
+            if (node->in_degree == 0) {
+                pool.submit([this, node = node.get(), &pool] { execute(node, pool); });
+            }
+        }
+
+        std::unique_lock<std::mutex> lock{mutex};
+        finished.wait(lock, [this] { return done; });
+    }
+};
+
+}
+
+template<typename T>
+class graph_node;
+
+/*
+ * A graph is a set of nodes, each a callable, with edges formed by the monadic operators on graph_nodes.
+ * i.e. node | then(f), when_all(nodes...) and when_any(nodes...) all add a new node, depending on their operands.
+ *
+ * run(pool) runs every node exactly once, in topological order, and blocks until they have all finished.
+ * A node is submitted to the pool as soon as its last dependency has finished (or its first, for when_any),
+ * so workers never block waiting on a dependency.  Since every node runs as soon as it can, manners are ignored.
+ *
+ * graph_nodes share ownership of their graph.  A node's value is available through node | get() after run.
+ */
+class graph
+{
+private:
+    template<typename T>
+    friend class graph_node;
+
+    std::shared_ptr<detail::GraphState> state;
+
+public:
+    graph() :
+        state{std::make_shared<detail::GraphState>()}
+    {}
+
+    template<typename Callable>
+    auto node(Callable&& callable)
+    {
+        using R = std::decay_t<std::invoke_result_t<std::decay_t<Callable>&>>;
+        using Body = std::decay_t<Callable>;
+        auto* node = state->add(std::make_unique<detail::BodyNode<R, Body>>(std::forward<Callable>(callable)), {});
+        return graph_node<R>{state, node};
+    }
+
+    /*
+     * The calling thread must not be one of pool's workers.
+     * Exceptions thrown by nodes are not rethrown here, but from node | get() on the failed node and its dependents.
+     */
+    void run(thread_pool& pool) const
+    {
+        state->run(pool);
+    }
+};
+
+template<typename T>
+class graph_node
+{
+private:
+    friend class graph;
+    template<typename U>
+    friend class graph_node;
+
+    std::shared_ptr<detail::GraphState> owner;
+    detail::ValueNode<T>* state;
+
+    graph_node(std::shared_ptr<detail::GraphState> owner, detail::ValueNode<T>* state) :
+        owner{std::move(owner)},
+        state{state}
+    {}
+
+public:
+    template<typename Body>
+    auto then(Body body) const
+    {
+        using R = std::decay_t<std::invoke_result_t<Body&>>;
+        auto* node = owner->add(std::make_unique<detail::BodyNode<R, Body>>(std::move(body)), {state});
+        return graph_node<R>{owner, node};
+    }
+
+    template<typename U, typename Body>
+    auto join(graph_node<U> const& rhs, Body body) const
+    {
+        using R = std::decay_t<std::invoke_result_t<Body&>>;
+        auto* node = owner->add(std::make_unique<detail::BodyNode<R, Body>>(std::move(body)), {state, rhs.state});
+        return graph_node<R>{owner, node};
+    }
+
+    graph_node any(graph_node const& rhs) const
+    {
+        auto* node = owner->add(std::make_unique<detail::AnyNode<T>>(), {state, rhs.state});
+        return graph_node{owner, node};
+    }
+
+    detail::ValueNode<T> const* get_state() const
+    {
+        return state;
+    }
+};
+
+template<typename T>
+T operator|(graph_node<T> const& node, Get<>)
+{
+    return node.get_state()->get();
+}
+
+template<typename T>
+graph_node<T> operator|(graph_node<T> node, Flatten)
+{
+    return node;
+}
+
+template<typename T, typename Invocable>
+auto operator|(graph_node<T> const& node, Then<Invocable> f)
+{
+    return node.then([predecessor = node.get_state(), f = std::move(f)] {
+        return f(predecessor->get());
+    });
+}
+
+template<typename T>
+When<graph_node<T>> operator^(When<graph_node<T>> const& lhs, graph_node<T> const& rhs)
+{
+    return {lhs.manner, lhs.value.any(rhs)};
+}
+
+template<typename... Ls, typename R>
+When<graph_node<std::tuple<Ls..., R>>> operator&(When<graph_node<std::tuple<Ls...>>> const& lhs, graph_node<R> const& rhs)
+{
+    return {lhs.manner, lhs.value.join(rhs, [l = lhs.value.get_state(), r = rhs.get_state()] {
+        return std::tuple_cat(l->get(), std::make_tuple(r->get()));
+    })};
+}
+
+}
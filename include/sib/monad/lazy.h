@@ -0,0 +1,333 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/monad/monad.h"
+#include "sib/shared_task.h"
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace sib::monad {
+
+namespace detail {
+
+template<typename R>
+struct ThunkOps
+{
+    R (*invoke)(void*);
+    void (*move)(void* from, void* to) noexcept;
+    void (*destroy)(void*) noexcept;
+    std::size_t size;
+    // For a callable stored in place: moves it to the heap, returning the pointer, and its ops there.
+    void* (*to_heap)(void*);
+    ThunkOps const* remote;
+};
+
+template<typename R, typename F>
+inline constexpr ThunkOps<R> remote_ops = {
+    [](void* self) -> R { return (**static_cast<F**>(self))(); },
+    [](void* from, void* to) noexcept { *static_cast<F**>(to) = *static_cast<F**>(from); },
+    [](void* self) noexcept { delete *static_cast<F**>(self); },
+    sizeof(F*),
+    nullptr,
+    nullptr
+};
+
+template<typename R, typename F>
+inline constexpr ThunkOps<R> local_ops = {
+    [](void* self) -> R { return (*static_cast<F*>(self))(); },
+    [](void* from, void* to) noexcept {
+        new (to) F{std::move(*static_cast<F*>(from))};
+        static_cast<F*>(from)->~F();
+    },
+    [](void* self) noexcept { static_cast<F*>(self)->~F(); },
+    sizeof(F),
+    [](void* from) -> void* {
+        auto* const result = new F{std::move(*static_cast<F*>(from))};
+        static_cast<F*>(from)->~F();
+        return result;
+    },
+    &remote_ops<R, F>
+};
+
+/*
+ * A move-only, type-erased R() that stores callables of up to Capacity bytes in place rather than on the heap.
+ * A Thunk of one capacity can take over the callable of another, moving it to the heap only if it does not fit.
+ */
+template<typename R, std::size_t Capacity>
+class Thunk
+{
+public:
+    static constexpr std::size_t capacity = Capacity;
+
+private:
+    template<typename, std::size_t>
+    friend class Thunk;
+
+    template<typename F>
+    static constexpr bool fits = sizeof(F) <= capacity && alignof(F) <= alignof(std::max_align_t) &&
+                                 std::is_nothrow_move_constructible_v<F>;
+
+    alignas(std::max_align_t) unsigned char buffer[capacity];
+    ThunkOps<R> const* ops;
+
+public:
+    template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Thunk>>>
+    explicit Thunk(F&& f) :
+        ops{nullptr}
+    {
+        using Callable = std::decay_t<F>;
+        if constexpr (fits<Callable>) {
+            new (buffer) Callable{std::forward<F>(f)};
+            ops = &local_ops<R, Callable>;
+        } else {
+            *reinterpret_cast<Callable**>(buffer) = new Callable{std::forward<F>(f)};
+            ops = &remote_ops<R, Callable>;
+        }
+    }
+
+    template<std::size_t Other, typename = std::enable_if_t<Other != Capacity>>
+    explicit Thunk(Thunk<R, Other>&& rhs) :
+        ops{nullptr}
+    {
+        if (!rhs.ops) {
+            return;
+        }
+        if (rhs.ops->size <= capacity) {
+            rhs.ops->move(rhs.buffer, buffer);
+            ops = rhs.ops;
+        } else {
+            *reinterpret_cast<void**>(buffer) = rhs.ops->to_heap(rhs.buffer);
+            ops = rhs.ops->remote;
+        }
+        rhs.ops = nullptr;
+    }
+
+    Thunk(Thunk&& rhs) noexcept :
+        ops{std::exchange(rhs.ops, nullptr)}
+    {
+        if (ops) {
+            ops->move(rhs.buffer, buffer);
+        }
+    }
+
+    Thunk& operator=(Thunk&& rhs) noexcept
+    {
+        if (this != &rhs) {
+            this->~Thunk();
+            new (this) Thunk{std::move(rhs)};
+        }
+        return *this;
+    }
+
+    ~Thunk() noexcept
+    {
+        if (ops) {
+            ops->destroy(buffer);
+        }
+    }
+
+    R operator()()
+    {
+        return ops->invoke(buffer);
+    }
+};
+
+// Room for a small callable: one capturing up to four pointers' worth.
+inline constexpr std::size_t callable_capacity = 4 * sizeof(void*);
+
+// What a combinator holds of each operand: its computation, as a small callable.
+template<typename R>
+using Operand = Thunk<R, callable_capacity>;
+
+// Room for a combinator over two operands, or one operand and a small callable (as then is), in place.
+inline constexpr std::size_t lazy_capacity = 2 * sizeof(Operand<int>);
+
+}
+
+/*
+ * lazy<T> is a value computed on first access, and remembered (as is any exception the computation throws).
+ * Unlike shared_task, it is for use on one thread: it has no atomics, and stores callables of up to
+ * detail::lazy_capacity bytes in place, so building and evaluating a small lazy does not touch the heap.
+ *
+ * lazy is move-only.  Composing with then, ^ or & takes each operand's computation out as a detail::Operand, rather
+ * than nesting whole lazies, so composing lazies of small callables with a small callable (or with each other)
+ * does not allocate either; deeper compositions do once their operands outgrow detail::callable_capacity.
+ * Combinators run their operands in sequence, whatever the manner.
+ * To use the value from several threads, convert it with lazy | share().
+ */
+template<typename T>
+class lazy
+{
+    static_assert(!std::is_void_v<T> && !std::is_reference_v<T>, "lazy holds a value");
+
+private:
+    // monostate while the value is being computed, or after it has been moved out.
+    mutable std::variant<std::monostate, detail::Thunk<T, detail::lazy_capacity>, T, std::exception_ptr> state;
+
+    void evaluate() const
+    {
+        if (auto* const thunk = std::get_if<detail::Thunk<T, detail::lazy_capacity>>(&state)) {
+            auto f = std::move(*thunk);
+            state.template emplace<std::monostate>();
+            try {
+                state.template emplace<T>(f());
+            } catch (...) {
+                state.template emplace<std::exception_ptr>(std::current_exception());
+            }
+        }
+    }
+
+public:
+    template<typename Callable,
+             typename = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, lazy> &&
+                                         std::is_invocable_r_v<T, std::decay_t<Callable>&>>>
+    explicit lazy(Callable&& callable) :
+        state{std::in_place_type<detail::Thunk<T, detail::lazy_capacity>>, std::forward<Callable>(callable)}
+    {}
+
+    lazy(lazy&&) noexcept = default;
+    lazy& operator=(lazy&&) noexcept = default;
+
+    /*
+     * Whether the value (or exception) has been computed.
+     */
+    bool ready() const noexcept
+    {
+        return std::holds_alternative<T>(state) || std::holds_alternative<std::exception_ptr>(state);
+    }
+
+    /*
+     * Computes the value if this is the first access, and returns it, or rethrows what computing it threw.
+     * Throws std::logic_error if the value is needed to compute itself, or has been moved out.
+     */
+    T const& value() const
+    {
+        evaluate();
+        if (auto const* const value = std::get_if<T>(&state)) {
+            return *value;
+        }
+        if (auto const* const error = std::get_if<std::exception_ptr>(&state)) {
+            std::rethrow_exception(*error);
+        }
+        throw std::logic_error{"lazy: value used during its own computation, or after being moved out"};
+    }
+
+    /*
+     * Hands over what is left to do for the value, as a callable returning it (or throwing what computing it threw),
+     * for combinators to compose.  The computation is not run, and this lazy is left as if moved out.
+     */
+    detail::Operand<T> defer() &&
+    {
+        auto state = std::exchange(this->state, std::monostate{});
+        if (auto* const thunk = std::get_if<detail::Thunk<T, detail::lazy_capacity>>(&state)) {
+            return detail::Operand<T>{std::move(*thunk)};
+        }
+        if (auto* const value = std::get_if<T>(&state)) {
+            return detail::Operand<T>{[value = std::move(*value)]() mutable -> T { return std::move(value); }};
+        }
+        if (auto const* const error = std::get_if<std::exception_ptr>(&state)) {
+            return detail::Operand<T>{[error = *error]() -> T { std::rethrow_exception(error); }};
+        }
+        return detail::Operand<T>{[]() -> T {
+            throw std::logic_error{"lazy: value used during its own computation, or after being moved out"};
+        }};
+    }
+
+    /*
+     * As value(), but moves the value out.
+     */
+    T take() &&
+    {
+        value();
+        auto result = std::move(std::get<T>(state));
+        state.template emplace<std::monostate>();
+        return result;
+    }
+};
+
+template<typename Callable>
+lazy(Callable) -> lazy<std::invoke_result_t<Callable&>>;
+
+template<typename T>
+T operator|(lazy<T> const& value, Get<>)
+{
+    return value.value();
+}
+
+template<typename T>
+T operator|(lazy<T>&& value, Get<>)
+{
+    return std::move(value).take();
+}
+
+template<typename T>
+lazy<T> operator|(lazy<T> value, Flatten)
+{
+    return value;
+}
+
+template<typename T>
+lazy<T> operator|(lazy<lazy<T>> value, Flatten)
+{
+    return lazy<T>{[value = std::move(value).defer()]() mutable {
+        return value().take();
+    }};
+}
+
+template<typename T, typename Invocable>
+auto operator|(lazy<T> value, Then<Invocable> f)
+{
+    using Result = std::invoke_result_t<Then<Invocable>&, T>;
+    return lazy<Result>{[value = std::move(value).defer(), f = std::move(f)]() mutable -> Result {
+        return f(value());
+    }} | flatten();
+}
+
+/*
+ * The value of lhs, unless computing it throws, in which case that of rhs.
+ */
+template<typename T>
+When<lazy<T>> operator^(When<lazy<T>> lhs, lazy<T> rhs)
+{
+    return {lhs.manner, lazy<T>{[lhs = std::move(lhs.value).defer(), rhs = std::move(rhs).defer()]() mutable -> T {
+        try {
+            return lhs();
+        } catch (...) {
+            return rhs();
+        }
+    }}};
+}
+
+template<typename... Ls, typename R>
+When<lazy<std::tuple<Ls..., R>>> operator&(When<lazy<std::tuple<Ls...>>> lhs, lazy<R> rhs)
+{
+    return {lhs.manner, lazy<std::tuple<Ls..., R>>{[lhs = std::move(lhs.value).defer(), rhs = std::move(rhs).defer()]() mutable {
+        auto lresult = lhs();
+        return std::tuple_cat(std::move(lresult), std::make_tuple(rhs()));
+    }}};
+}
+
+/*
+ * lazy | share() converts a lazy into a shared_task, which computes the value (if it has not been already) on the
+ * first call, from whichever thread that comes.
+ */
+template<typename T>
+shared_task<T()> operator|(lazy<T> value, Share)
+{
+    return shared_task<T()>{[value = std::move(value)]() mutable {
+        return std::move(value).take();
+    }};
+}
+
+}
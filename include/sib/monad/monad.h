@@ -5,14 +5,47 @@
 
 #pragma once
 
+#include <functional>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
 namespace sib::monad {
 
+namespace detail {
+
+/*
+ * std::invoke and std::apply are not constexpr until C++20, so the tags use these instead.
+ * Pointers to members, which cannot be called directly, still go through std::invoke.
+ */
+template<typename Invocable, typename... Args>
+constexpr decltype(auto) invoke(Invocable&& f, Args&&... args)
+{
+    if constexpr (std::is_member_pointer_v<std::decay_t<Invocable>>) {
+        return std::invoke(std::forward<Invocable>(f), std::forward<Args>(args)...);
+    } else {
+        return std::forward<Invocable>(f)(std::forward<Args>(args)...);
+    }
+}
+
+template<typename Applicable, typename Tuple, std::size_t... Is>
+constexpr decltype(auto) apply(Applicable&& f, Tuple&& tuple, std::index_sequence<Is...>)
+{
+    return detail::invoke(std::forward<Applicable>(f), std::get<Is>(std::forward<Tuple>(tuple))...);
+}
+
+template<typename Applicable, typename Tuple>
+constexpr decltype(auto) apply(Applicable&& f, Tuple&& tuple)
+{
+    return detail::apply(std::forward<Applicable>(f), std::forward<Tuple>(tuple),
+                         std::make_index_sequence<std::tuple_size_v<std::remove_reference_t<Tuple>>>{});
+}
+
+}
+
 static inline constexpr struct {
     template<typename T>
-    auto operator()(T&& value) const
+    constexpr auto operator()(T&& value) const
     {
         return std::forward<T>(value);
     }
@@ -20,7 +53,7 @@ static inline constexpr struct {
 
 static inline constexpr struct {
     template<typename T>
-    auto operator()(T&& value) const
+    constexpr auto operator()(T&& value) const
     {
         return std::make_tuple(std::forward<T>(value));
     }
@@ -33,15 +66,15 @@ struct Get
 };
 static inline constexpr struct {
     template<typename... Args>
-    Get<Args...> operator()(Args&& ... args) const
+    constexpr Get<Args...> operator()(Args&& ... args) const
     {
-        return Get<Args...>{std::forward<Args>(args)...};
+        return Get<Args...>{std::tuple<Args...>{std::forward<Args>(args)...}};
     }
 } get;
 
 class Flatten {};
 static inline constexpr struct {
-    Flatten operator()() const
+    constexpr Flatten operator()() const
     {
         return Flatten{};
     }
@@ -54,25 +87,25 @@ private:
     Invocable invocable;
 
 public:
-    explicit Then(Invocable callable)
+    constexpr explicit Then(Invocable callable)
         : invocable{std::move(callable)}
     {}
 
     template<typename... Args>
-    auto operator()(Args&&... args) const &
+    constexpr auto operator()(Args&&... args) const &
     {
-        return std::invoke(invocable, std::forward<Args>(args)...);
+        return detail::invoke(invocable, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
-    auto operator()(Args&&... args) &&
+    constexpr auto operator()(Args&&... args) &&
     {
-        return std::invoke(std::move(invocable), std::forward<Args>(args)...);
+        return detail::invoke(std::move(invocable), std::forward<Args>(args)...);
     }
 };
 static constexpr inline struct {
     template<typename Invocable>
-    Then<std::decay_t<Invocable>> operator()(Invocable&& invocable) const
+    constexpr Then<std::decay_t<Invocable>> operator()(Invocable&& invocable) const
     {
         return Then<std::decay_t<Invocable>>{std::forward<Invocable>(invocable)};
     }
@@ -85,133 +118,172 @@ private:
     Applicable applicable;
 
 public:
-    explicit Apply(Applicable callable)
+    constexpr explicit Apply(Applicable callable)
             : applicable{std::move(callable)}
     {}
 
     template<typename... Args>
-    auto operator()(Args&&... args) const &
+    constexpr auto operator()(Args&&... args) const &
     {
-        return std::apply(applicable, std::forward<Args>(args)...);
+        return detail::apply(applicable, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
-    auto operator()(Args&&... args) &&
+    constexpr auto operator()(Args&&... args) &&
     {
-        return std::apply(std::move(applicable), std::forward<Args>(args)...);
+        return detail::apply(std::move(applicable), std::forward<Args>(args)...);
     }
 };
 static constexpr inline struct {
     template<typename Applicable>
-    Apply<std::decay_t<Applicable>> operator()(Applicable&& applicable) const
+    constexpr Apply<std::decay_t<Applicable>> operator()(Applicable&& applicable) const
     {
         return Apply<std::decay_t<Applicable>>{std::forward<Applicable>(applicable)};
     }
 } apply;
 
 template<typename Tuple, typename Applicable>
-auto operator|(Tuple&& tuple, Apply<Applicable> const& f)
+constexpr auto operator|(Tuple&& tuple, Apply<Applicable> const& f)
 {
     return std::forward<Tuple>(tuple) | then(f);
 }
 
 template<typename Tuple, typename Applicable>
-auto operator|(Tuple&& tuple, Apply<Applicable>&& f)
+constexpr auto operator|(Tuple&& tuple, Apply<Applicable>&& f)
 {
     return std::forward<Tuple>(tuple) | then(std::move(f));
 }
 
-enum class in : bool { sequence = false, parallel = true };
+/*
+ * How a combinator runs its operands.
+ * automatic runs them in sequence or in parallel depending on how long they have taken before;
+ * monads that cannot measure their operands treat it as sequence.
+ */
+enum class in : unsigned char { sequence, parallel, automatic };
 template<typename T>
 struct When
 {
     in manner;
     T value;
+    // How many combinators value already nests, for those whose cost depends on it (e.g. a chain of task ^ task).
+    std::size_t depth = 0;
 };
 template<typename T>
-When<std::decay_t<T>> operator^(in manner, T&& value)
+constexpr When<std::decay_t<T>> operator^(in manner, T&& value)
 {
     return {manner, std::forward<T>(value)};
 }
 
 template<typename T, typename... Args>
-auto operator|(When<T>&& when, Get<Args...>&& g)
+constexpr auto operator|(When<T>&& when, Get<Args...>&& g)
 {
     return std::move(when.value) | std::move(g);
 }
 
 template<typename T, typename... Args>
-auto operator|(When<T> const& when, Get<Args...>&& g)
+constexpr auto operator|(When<T> const& when, Get<Args...>&& g)
 {
     return when.value | std::move(g);
 }
 
 template<typename T, typename... Args>
-auto operator|(When<T>&& when, Get<Args...> const& g)
+constexpr auto operator|(When<T>&& when, Get<Args...> const& g)
 {
     return std::move(when.value) | g;
 }
 
 template<typename T, typename... Args>
-auto operator|(When<T> const& when, Get<Args...> const& g)
+constexpr auto operator|(When<T> const& when, Get<Args...> const& g)
 {
     return when.value | g;
 }
 
 template<typename T, typename Invocable>
-auto operator|(When<T>&& when, Then<Invocable>&& f)
+constexpr auto operator|(When<T>&& when, Then<Invocable>&& f)
 {
     return std::move(when.value) | std::move(f);
 }
 
 template<typename T, typename Invocable>
-auto operator|(When<T> const& when, Then<Invocable>&& f)
+constexpr auto operator|(When<T> const& when, Then<Invocable>&& f)
 {
     return when.value | std::move(f);
 }
 
 template<typename T, typename Invocable>
-auto operator|(When<T>&& when, Then<Invocable> const& f)
+constexpr auto operator|(When<T>&& when, Then<Invocable> const& f)
 {
     return std::move(when.value) | f;
-
 }
 
 template<typename T, typename Invocable>
-auto operator|(When<T> const& when, Then<Invocable> const& f)
+constexpr auto operator|(When<T> const& when, Then<Invocable> const& f)
 {
     return when.value | f;
 }
 
+// Builds the When directly around the prvalue, rather than through operator^, so that the result is never moved.
+// (That also keeps it constexpr for optionals, whose moves of non-trivial values are not constexpr in C++17.)
 template<typename Monad>
-auto operator&(in manner, Monad&& monad)
+constexpr auto operator&(in manner, Monad&& monad)
 {
-    return manner ^ (std::forward<Monad>(monad) | then(make_tuple));
+    using Result = decltype(std::forward<Monad>(monad) | then(make_tuple));
+    return When<Result>{manner, std::forward<Monad>(monad) | then(make_tuple)};
 }
 
-static inline constexpr struct {
+/*
+ * By default, when_any folds operator^ over its operands.
+ * A monad may specialise WhenAny to combine all of its operands in a single pass instead.
+ */
+template<typename... Monads>
+struct WhenAny
+{
     template<typename Head, typename... Tail>
-    auto operator()(in manner, Head&& head, Tail&& ... tail) const
+    static constexpr auto combine(in manner, Head&& head, Tail&& ... tail)
     {
         return ((manner ^ std::forward<Head>(head)) ^ ... ^ std::forward<Tail>(tail)).value;
     }
+};
+
+static inline constexpr struct {
+    template<typename Head, typename... Tail>
+    constexpr auto operator()(in manner, Head&& head, Tail&& ... tail) const
+    {
+        return WhenAny<std::decay_t<Head>, std::decay_t<Tail>...>::combine(
+            manner, std::forward<Head>(head), std::forward<Tail>(tail)...);
+    }
 
     template<typename Head, typename... Tail>
-    auto operator()(Head&& head, Tail&& ... tail) const
+    constexpr auto operator()(Head&& head, Tail&& ... tail) const
     {
         return (*this)(in::sequence, std::forward<Head>(head), std::forward<Tail>(tail)...);
     }
 } when_any;
 
-static constexpr inline struct {
+/*
+ * By default, when_all folds operator& over its operands.
+ * A monad may specialise WhenAll to combine all of its operands in a single pass instead.
+ */
+template<typename... Monads>
+struct WhenAll
+{
     template<typename Head, typename... Tail>
-    auto operator()(in manner, Head&& head, Tail&& ... tail) const
+    static constexpr auto combine(in manner, Head&& head, Tail&& ... tail)
     {
         return ((manner & std::forward<Head>(head)) & ... & std::forward<Tail>(tail)).value;
     }
+};
+
+static constexpr inline struct {
+    template<typename Head, typename... Tail>
+    constexpr auto operator()(in manner, Head&& head, Tail&& ... tail) const
+    {
+        return WhenAll<std::decay_t<Head>, std::decay_t<Tail>...>::combine(
+            manner, std::forward<Head>(head), std::forward<Tail>(tail)...);
+    }
 
     template<typename Head, typename... Tail>
-    auto operator()(Head&& head, Tail&& ... tail) const
+    constexpr auto operator()(Head&& head, Tail&& ... tail) const
     {
         return (*this)(in::sequence, std::forward<Head>(head), std::forward<Tail>(tail)...);
     }
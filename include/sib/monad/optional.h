@@ -6,105 +6,170 @@
 #pragma once
 
 #include "sib/monad/monad.h"
+#include <functional>
 #include <optional>
+#include <type_traits>
 
 namespace sib::monad {
 
 template<typename T>
-T operator|(std::optional<T> const& opt, Get<>)
+constexpr T operator|(std::optional<T> const& opt, Get<>)
 {
     return opt.value();
 }
 
 template<typename T>
-T operator|(std::optional<T>&& opt, Get<>)
+constexpr T operator|(std::optional<T>&& opt, Get<>)
 {
     return std::move(opt).value();
 }
 
 template<typename T>
-std::optional<T> operator|(std::optional<T> opt, Flatten)
+constexpr std::optional<T> operator|(std::optional<T> opt, Flatten)
 {
     return std::move(opt);
 }
 
 template<typename T>
-std::optional<T> operator|(std::optional<std::optional<T>> opt, Flatten)
+constexpr std::optional<T> operator|(std::optional<std::optional<T>> opt, Flatten)
 {
     return std::move(opt).value_or(std::nullopt);
 }
 
+namespace detail {
+
+template<typename T>
+struct IsOptional : std::false_type {};
+
+template<typename T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+
+// Converts to the result of invoking f with arg, so that optional's in_place constructor constructs that
+// result in place.  (emplace would do the same, but is not constexpr.)
+template<typename Invocable, typename Arg>
+struct Invoke
+{
+    Invocable&& f;
+    Arg&& arg;
+
+    constexpr operator std::invoke_result_t<Invocable, Arg>() &&
+    {
+        return detail::invoke(std::forward<Invocable>(f), std::forward<Arg>(arg));
+    }
+};
+
+// A type that converts to nothing.  A Result constructible from it has a constructor that accepts any argument
+// (as std::any does), which would be chosen over Invoke's conversion and so store the Invoke itself.
+struct Unrelated {};
+
+template<typename Result>
+inline constexpr bool constructs_through_conversion = !std::is_constructible_v<Result, Unrelated&&>;
+
+template<typename Result, typename Optional, typename Invocable>
+constexpr std::optional<Result> then_in_place(Optional&& opt, Invocable&& f)
+{
+    if (opt) {
+        if constexpr (constructs_through_conversion<Result>) {
+            return std::optional<Result>{std::in_place, Invoke<Invocable, decltype(*std::forward<Optional>(opt))>{
+                std::forward<Invocable>(f), *std::forward<Optional>(opt)
+            }};
+        } else {
+            return std::optional<Result>{std::in_place,
+                                         detail::invoke(std::forward<Invocable>(f), *std::forward<Optional>(opt))};
+        }
+    }
+    return std::nullopt;
+}
+
+/*
+ * opt | then(f) is the if-statement we would otherwise write by hand.
+ * If f returns an optional, that is the result (with no rewrapping); otherwise f's result is constructed in place.
+ */
+template<typename Optional, typename Invocable>
+constexpr auto then(Optional&& opt, Invocable&& f)
+{
+    using Result = std::invoke_result_t<Invocable, decltype(*std::forward<Optional>(opt))>;
+    if constexpr (IsOptional<Result>::value) {
+        return opt ? detail::invoke(std::forward<Invocable>(f), *std::forward<Optional>(opt)) : Result{std::nullopt};
+    } else {
+        return then_in_place<Result>(std::forward<Optional>(opt), std::forward<Invocable>(f));
+    }
+}
+
+}
+
 template<typename T, typename Invocable>
-auto operator|(std::optional<T> const& opt, Then<Invocable> const& f)
+constexpr auto operator|(std::optional<T> const& opt, Then<Invocable> const& f)
 {
-    using Result = decltype(std::invoke(f, *opt));
-    using Flattened = decltype(std::optional<Result>{} | flatten());
-    return opt ?
-        std::optional<Result>{std::invoke(f, *opt)} | flatten() :
-        Flattened{std::nullopt};
+    return detail::then(opt, f);
 }
 
 template<typename T, typename Invocable>
-auto operator|(std::optional<T>&& opt, Then<Invocable> const& f)
+constexpr auto operator|(std::optional<T>&& opt, Then<Invocable> const& f)
 {
-    using Result = decltype(std::invoke(f, std::move(opt) | get()));
-    using Flattened = decltype(std::optional<Result>{} | flatten());
-    return opt ?
-           std::optional<Result>{std::invoke(f, std::move(opt) | get())} | flatten() :
-           Flattened{std::nullopt};
+    return detail::then(std::move(opt), f);
 }
 
 template<typename T, typename Invocable>
-auto operator|(std::optional<T> const& opt, Then<Invocable>&& f)
+constexpr auto operator|(std::optional<T> const& opt, Then<Invocable>&& f)
 {
-    using Result = decltype(std::invoke(std::move(f), *opt));
-    using Flattened = decltype(std::optional<Result>{} | flatten());
-    return opt ?
-           std::optional<Result>{std::invoke(std::move(f), *opt)} | flatten() :
-           Flattened{std::nullopt};
+    return detail::then(opt, std::move(f));
 }
 
 template<typename T, typename Invocable>
-auto operator|(std::optional<T>&& opt, Then<Invocable>&& f)
+constexpr auto operator|(std::optional<T>&& opt, Then<Invocable>&& f)
 {
-    using Result = decltype(std::invoke(std::move(f), *std::move(opt)));
-    using Flattened = decltype(std::optional<Result>{} | flatten());
-    return opt ?
-           std::optional<Result>{std::invoke(std::move(f), *std::move(opt))} | flatten() :
-           Flattened{std::nullopt};
+    return detail::then(std::move(opt), std::move(f));
 }
 
 template<typename T>
-When<std::optional<T>> operator^(When<std::optional<T>> const& lhs, std::optional<T> const& rhs)
+constexpr When<std::optional<T>> operator^(When<std::optional<T>> const& lhs, std::optional<T> const& rhs)
 {
     return {lhs.manner, lhs.value ? lhs.value : rhs};
 }
 
 template<typename T>
-When<std::optional<T>> operator^(When<std::optional<T>>&& lhs, std::optional<T> const& rhs)
+constexpr When<std::optional<T>> operator^(When<std::optional<T>>&& lhs, std::optional<T> const& rhs)
 {
     return {lhs.manner, lhs.value ? std::move(lhs.value) : rhs};
 }
 
 template<typename T>
-When<std::optional<T>> operator^(When<std::optional<T> const>& lhs, std::optional<T>&& rhs)
+constexpr When<std::optional<T>> operator^(When<std::optional<T>> const& lhs, std::optional<T>&& rhs)
 {
-    return {lhs.manner, lhs ? lhs : std::move(rhs)};
+    return {lhs.manner, lhs.value ? lhs.value : std::move(rhs)};
 }
 
 template<typename T>
-When<std::optional<T>> operator^(When<std::optional<T>>&& lhs, std::optional<T>&& rhs)
+constexpr When<std::optional<T>> operator^(When<std::optional<T>>&& lhs, std::optional<T>&& rhs)
 {
-    return {lhs.manner, lhs ? std::move(lhs) : std::move(rhs)};
+    return {lhs.manner, lhs.value ? std::move(lhs.value) : std::move(rhs)};
 }
 
 template<typename... Ls, typename R>
-When<std::optional<std::tuple<Ls..., R>>> operator&(When<std::optional<std::tuple<Ls...>>> lhs, std::optional<R> rhs)
+constexpr When<std::optional<std::tuple<Ls..., R>>> operator&(When<std::optional<std::tuple<Ls...>>> lhs, std::optional<R> rhs)
 {
-    return lhs.manner ^ (lhs.value && rhs ?
-        std::optional<std::tuple<Ls..., R>>{std::tuple_cat(lhs | get(), std::move(rhs) | then(make_tuple) | get())} :
+    return {lhs.manner, lhs.value && rhs ?
+        std::optional<std::tuple<Ls..., R>>{std::tuple_cat(std::move(*lhs.value), std::tuple<R>{std::move(*rhs)})} :
         std::optional<std::tuple<Ls..., R>>{}
-    );
+    };
 }
 
+/*
+ * when_all over optionals checks every operand up front, then moves (or copies, for lvalues) each value
+ * into the result exactly once.
+ */
+template<typename... Ts>
+struct WhenAll<std::optional<Ts>...>
+{
+    template<typename... Optionals>
+    static constexpr std::optional<std::tuple<Ts...>> combine(in, Optionals&&... opts)
+    {
+        if ((opts.has_value() && ...)) {
+            return std::optional<std::tuple<Ts...>>{std::in_place, *std::forward<Optionals>(opts)...};
+        }
+        return std::nullopt;
+    }
+};
+
 }
@@ -0,0 +1,297 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/monad/monad.h"
+#include "sib/spsc_queue.h"
+#include <array>
+#include <chrono>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace sib::monad {
+
+/*
+ * Statistics gathered for one stage of a pipeline during one run.
+ * busy only counts time spent inside the stage's callable, so the stage with the lowest throughput is the bottleneck.
+ */
+struct stage_stats
+{
+    std::size_t items = 0;
+    std::chrono::nanoseconds busy{0};
+
+    double throughput() const
+    {
+        return busy.count() == 0 ? 0.0 : static_cast<double>(items) * 1e9 / static_cast<double>(busy.count());
+    }
+};
+
+namespace detail {
+
+// Computes std::tuple<Input, Stage1Result, ..., StageNResult>: the input type of every stage, plus the final result.
+template<typename T, typename... Invocables>
+struct PipelineTypes
+{
+    using types = std::tuple<T>;
+};
+
+template<typename T, typename Invocable, typename... Invocables>
+struct PipelineTypes<T, Invocable, Invocables...>
+{
+    using Result = decltype(std::declval<Then<Invocable> const&>()(std::declval<T>()));
+    using types = decltype(std::tuple_cat(std::declval<std::tuple<T>>(),
+                                          std::declval<typename PipelineTypes<Result, Invocables...>::types>()));
+};
+
+}
+
+/*
+ * A Pipeline is a sequence of then stages, applied in turn to every item of a range.
+ * Built with pipeline(manner) | then(f) | then(g) ... and run with | get(range), which returns a std::vector of results.
+ *
+ * In sequence, each item passes through every stage on the calling thread.
+ * In parallel, each stage runs on its own thread, joined to the next by a bounded spsc_queue of the given capacity,
+ * so that different stages work on different items at the same time.  Results are always in input order.
+ */
+template<typename... Invocables>
+class Pipeline
+{
+private:
+    template<typename...>
+    friend class Pipeline;
+
+    in manner;
+    std::size_t capacity;
+    std::tuple<Then<Invocables>...> stages;
+
+    using Stats = std::array<stage_stats, sizeof...(Invocables)>;
+
+    // Each run gathers its own statistics, and only publishes them here once it has finished.
+    struct Published
+    {
+        std::mutex mutex;
+        Stats stats{};
+    };
+    std::shared_ptr<Published> statistics;
+
+    template<typename Input>
+    using Types = typename detail::PipelineTypes<Input, Invocables...>::types;
+
+    template<typename Input>
+    using Result = std::tuple_element_t<sizeof...(Invocables), Types<Input>>;
+
+    template<std::size_t I, typename T>
+    auto invoke_stage(T&& item, stage_stats& stats) const
+    {
+        auto const start = std::chrono::steady_clock::now();
+        auto result = std::get<I>(stages)(std::forward<T>(item));
+        stats.busy += std::chrono::steady_clock::now() - start;
+        ++stats.items;
+        return result;
+    }
+
+    template<std::size_t I, typename T>
+    auto invoke_stages(T&& item, Stats& stats) const
+    {
+        if constexpr (I == sizeof...(Invocables)) {
+            return std::forward<T>(item);
+        } else {
+            return invoke_stages<I + 1>(invoke_stage<I>(std::forward<T>(item), stats[I]), stats);
+        }
+    }
+
+    template<typename Input, typename Begin, typename End>
+    std::vector<Result<Input>> run_sequence(Begin begin, End end, Stats& stats) const
+    {
+        std::vector<Result<Input>> results;
+        for (; begin != end; ++begin) {
+            results.push_back(invoke_stages<0>(*begin, stats));
+        }
+        return results;
+    }
+
+    template<typename Input, typename Begin, typename End, std::size_t... Is>
+    std::vector<Result<Input>> run_parallel(Begin begin, End end, Stats& stats, std::index_sequence<Is...>) const
+    {
+        // queue I feeds stage I.  An empty optional marks the end of the stream.
+        std::tuple<spsc_queue<std::optional<std::tuple_element_t<Is, Types<Input>>>>...> queues{
+            (static_cast<void>(Is), capacity)...
+        };
+        std::vector<Result<Input>> results;
+
+        // After the first exception, stages keep draining their input (so that nothing upstream blocks),
+        // but stop invoking their callables.
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto const stage = [&](auto index) {
+            constexpr std::size_t I = decltype(index)::value;
+            using Output = std::tuple_element_t<I + 1, Types<Input>>;
+            auto& input = std::get<I>(queues);
+            for (auto item = input.pop(); item; item = input.pop()) {
+                if (failed.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                try {
+                    auto output = invoke_stage<I>(std::move(*item), stats[I]);
+                    if constexpr (I + 1 == sizeof...(Invocables)) {
+                        results.push_back(std::move(output));
+                    } else {
+                        std::get<I + 1>(queues).push(std::optional<Output>{std::move(output)});
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> const lock{error_mutex};
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            if constexpr (I + 1 != sizeof...(Invocables)) {
+                std::get<I + 1>(queues).push(std::optional<Output>{});
+            }
+        };
+
+        auto& source = std::get<0>(queues);
+        std::array<std::thread, sizeof...(Is)> threads;
+
+        // Ends the stream and waits for every running stage to drain it.
+        auto const finish = [&] {
+            source.push(std::optional<Input>{});
+            for (auto& thread : threads) {
+                if (thread.joinable()) {
+                    thread.join();
+                }
+            }
+        };
+
+        // Start the stages in order, so that if one fails to start, those before it are all running.
+        // Whatever fails, whether starting a stage or reading the range, the stream is ended and the stages joined
+        // rather than destroyed while joinable.
+        try {
+            (static_cast<void>(threads[Is] = std::thread{stage, std::integral_constant<std::size_t, Is>{}}), ...);
+            for (; begin != end && !failed.load(std::memory_order_relaxed); ++begin) {
+                source.push(std::optional<Input>{*begin});
+            }
+        } catch (...) {
+            finish();
+            throw;
+        }
+        finish();
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return results;
+    }
+
+public:
+    Pipeline(in manner, std::size_t capacity, std::tuple<Then<Invocables>...> stages) :
+        manner{manner},
+        capacity{capacity},
+        stages{std::move(stages)},
+        statistics{std::make_shared<Published>()}
+    {}
+
+    /*
+     * Per-stage statistics of the most recently completed run, in stage order.
+     * Copies of a Pipeline share their statistics, and may run concurrently: each run gathers its own,
+     * and the last to complete is the one returned.
+     */
+    Stats stats() const
+    {
+        std::lock_guard<std::mutex> const lock{statistics->mutex};
+        return statistics->stats;
+    }
+
+    template<typename Invocable>
+    Pipeline<Invocables..., Invocable> append(Then<Invocable> f) &&
+    {
+        return {manner, capacity, std::tuple_cat(std::move(stages), std::make_tuple(std::move(f)))};
+    }
+
+    template<typename Invocable>
+    Pipeline<Invocables..., Invocable> append(Then<Invocable> f) const &
+    {
+        return {manner, capacity, std::tuple_cat(stages, std::make_tuple(std::move(f)))};
+    }
+
+    template<typename Range>
+    auto run(Range&& range) const
+    {
+        using Input = std::decay_t<decltype(*std::begin(range))>;
+        Stats stats{};
+
+        // Only move out of the range if we were given ownership of it.
+        auto const begin = [&]{
+            if constexpr (std::is_lvalue_reference_v<Range>) {
+                return std::begin(range);
+            } else {
+                return std::make_move_iterator(std::begin(range));
+            }
+        }();
+        auto const end = [&]{
+            if constexpr (std::is_lvalue_reference_v<Range>) {
+                return std::end(range);
+            } else {
+                return std::make_move_iterator(std::end(range));
+            }
+        }();
+
+        auto results = [&] {
+            if constexpr (sizeof...(Invocables) == 0) {
+                return run_sequence<Input>(begin, end, stats);
+            } else {
+                return manner == in::parallel ?
+                    run_parallel<Input>(begin, end, stats, std::index_sequence_for<Invocables...>{}) :
+                    run_sequence<Input>(begin, end, stats);
+            }
+        }();
+
+        std::lock_guard<std::mutex> const lock{statistics->mutex};
+        statistics->stats = stats;
+        return results;
+    }
+};
+
+static inline constexpr struct {
+    Pipeline<> operator()(in manner = in::sequence, std::size_t capacity = 1024) const
+    {
+        return {manner, capacity, {}};
+    }
+} pipeline;
+
+template<typename... Invocables, typename Invocable>
+Pipeline<Invocables..., Invocable> operator|(Pipeline<Invocables...>&& p, Then<Invocable> f)
+{
+    return std::move(p).append(std::move(f));
+}
+
+template<typename... Invocables, typename Invocable>
+Pipeline<Invocables..., Invocable> operator|(Pipeline<Invocables...> const& p, Then<Invocable> f)
+{
+    return p.append(std::move(f));
+}
+
+template<typename... Invocables, typename Range>
+auto operator|(Pipeline<Invocables...> const& p, Get<Range>&& g)
+{
+    return p.run(std::get<0>(std::move(g.args)));
+}
+
+template<typename... Invocables, typename Range>
+auto operator|(Pipeline<Invocables...> const& p, Get<Range> const& g)
+{
+    return p.run(std::get<0>(g.args));
+}
+
+}
@@ -0,0 +1,244 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/monad/monad.h"
+#include "sib/executor.h"
+#include "sib/shared_task.h"
+#include "sib/timer_queue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <random>
+#include <tuple>
+#include <type_traits>
+
+namespace sib::monad {
+
+/*
+ * How | retry(policy) retries.
+ * Before retry n (counting from 1) it waits for a random time between zero and
+ * min(max_delay, initial_delay * multiplier^(n-1)) ("full jitter"), or for exactly that long without jitter.
+ */
+struct retry_policy
+{
+    std::size_t max_attempts = 3;
+    std::chrono::nanoseconds initial_delay = std::chrono::milliseconds{1};
+    std::chrono::nanoseconds max_delay = std::chrono::seconds{1};
+    double multiplier = 2.0;
+    bool jitter = true;
+    // Which exceptions are worth retrying; all of them if empty.
+    std::function<bool(std::exception_ptr const&)> retryable;
+
+    /*
+     * The longest wait before retry n.
+     */
+    std::chrono::nanoseconds backoff(std::size_t retry) const
+    {
+        auto delay = static_cast<double>(initial_delay.count());
+        auto const limit = static_cast<double>(max_delay.count());
+        for (std::size_t i = 1; i < retry && delay < limit; ++i) {
+            delay *= multiplier;
+        }
+        return std::chrono::nanoseconds{static_cast<std::int64_t>(std::min(delay, limit))};
+    }
+
+    /*
+     * The wait before retry n, with jitter if enabled.
+     */
+    std::chrono::nanoseconds delay(std::size_t retry) const
+    {
+        auto const longest = backoff(retry);
+        if (!jitter || longest.count() <= 0) {
+            return longest;
+        }
+        static thread_local std::minstd_rand random{std::random_device{}()};
+        return std::chrono::nanoseconds{std::uniform_int_distribution<std::int64_t>{0, longest.count()}(random)};
+    }
+};
+
+/*
+ * Retries a call, after a backoff, while it fails, up to policy.max_attempts times in all.
+ * A failure is an exception the policy deems retryable, or an empty std::optional.  Once attempts run out, the last
+ * failure is returned (or rethrown).  Arguments are passed to each attempt afresh, so must be copyable.
+ *
+ * task | retry(policy).start(args...) retries a packaged_task without holding any thread between attempts.
+ * A timer_queue callback submits each retry to the executor that was current at the start (which must outlive them),
+ * and the last attempt fulfils the returned shared_task.
+ *
+ * f | retry(policy), for a std::function or packaged_task, makes one that retries when called.  It cannot be driven
+ * by timers: a call has to return its result, so the calling thread waits through every backoff (on a timer_queue
+ * future, waited for according to the current wait_policy, so only on a fiber_executor does it free the thread).
+ * Use it where the caller would block for the result anyway; otherwise prefer retry(policy).start(args...).
+ */
+template<typename... Args>
+struct RetryStart
+{
+    retry_policy policy;
+    std::tuple<Args...> args;
+};
+
+class Retry
+{
+public:
+    retry_policy policy;
+
+    template<typename... Args>
+    RetryStart<std::decay_t<Args>...> start(Args&&... args) const
+    {
+        return {policy, {std::forward<Args>(args)...}};
+    }
+};
+static inline constexpr struct {
+    Retry operator()(retry_policy policy = {}) const
+    {
+        return Retry{std::move(policy)};
+    }
+} retry;
+
+namespace detail {
+
+template<typename T>
+bool failed(T const&) noexcept
+{
+    return false;
+}
+
+template<typename T>
+bool failed(std::optional<T> const& result) noexcept
+{
+    return !result.has_value();
+}
+
+template<typename R, typename Attempt>
+R with_retries(retry_policy const& policy, Attempt&& attempt)
+{
+    for (std::size_t n = 1;; ++n) {
+        auto const last = n >= policy.max_attempts;
+        try {
+            if constexpr (std::is_void_v<R>) {
+                attempt();
+                return;
+            } else {
+                auto result = attempt();
+                if (last || !failed(result)) {
+                    return result;
+                }
+            }
+        } catch (...) {
+            if (last || (policy.retryable && !policy.retryable(std::current_exception()))) {
+                throw;
+            }
+        }
+        current_wait_policy().wait(timer_queue::global().after(policy.delay(n)));
+    }
+}
+
+template<typename R, typename... Args>
+struct Retrying
+{
+    std::packaged_task<R(Args...)> task;
+    retry_policy policy;
+    std::tuple<std::decay_t<Args>...> args;
+    std::promise<R> result;
+    executor* exec;
+};
+
+// Makes attempt n and, if it is to be retried, sets a timer to submit the next.  In between, only the timer holds state.
+template<typename R, typename... Args>
+void retry_from(std::shared_ptr<Retrying<R, Args...>> state, std::size_t n)
+{
+    auto const& policy = state->policy;
+    auto const last = n >= policy.max_attempts;
+    try {
+        auto& task = state->task;
+        task.reset();
+        auto future = task.get_future();
+        std::apply([&task](auto const&... args) { task(args...); }, state->args);
+        if constexpr (std::is_void_v<R>) {
+            future.get();
+            state->result.set_value();
+            return;
+        } else {
+            auto result = future.get();
+            if (last || !failed(result)) {
+                state->result.set_value(std::move(result));
+                return;
+            }
+        }
+    } catch (...) {
+        if (last || (policy.retryable && !policy.retryable(std::current_exception()))) {
+            state->result.set_exception(std::current_exception());
+            return;
+        }
+    }
+    timer_queue::global().after(policy.delay(n), [state, n] {
+        executor::scope const scope{state->exec};
+        spawn([state, n] { retry_from(state, n + 1); });
+    });
+}
+
+}
+
+template<typename R, typename... Args>
+std::function<R(Args...)> operator|(std::function<R(Args...)> function, Retry r)
+{
+    return [function = std::move(function), policy = std::move(r.policy)](Args... args) {
+        return detail::with_retries<R>(policy, [&function, &args...] { return function(args...); });
+    };
+}
+
+template<typename R, typename... Args>
+std::packaged_task<R(Args...)> operator|(std::packaged_task<R(Args...)> task, Retry r)
+{
+    return std::packaged_task<R(Args...)>{
+#ifdef _MSC_VER
+        // Capture by shared_ptr to work round bug in MSVC where packaged_task can't construct from a mutable lambda.
+        // See https://github.com/microsoft/STL/issues/321
+        [ptr = std::make_shared<decltype(task)>(std::move(task)), policy = std::move(r.policy)](Args... args) {
+            auto& task = *ptr;
+#else
+        [task = std::move(task), policy = std::move(r.policy)](Args... args) mutable {
+#endif
+            return detail::with_retries<R>(policy, [&task, &args...] {
+                // Each attempt needs a fresh shared state, which reset() gives without losing the callable.
+                task.reset();
+                auto future = task.get_future();
+                task(args...);
+                return future.get();
+            });
+        }
+    };
+}
+
+template<typename R, typename... Args, typename... SArgs>
+shared_task<R()> operator|(std::packaged_task<R(Args...)> task, RetryStart<SArgs...> s)
+{
+    auto const state = std::make_shared<detail::Retrying<R, Args...>>(detail::Retrying<R, Args...>{
+        std::move(task), std::move(s.policy), std::move(s.args), {}, executor::current()
+    });
+    auto future = state->result.get_future().share();
+    auto const job = spawn([state] { detail::retry_from(state, 1); });
+    return shared_task<R()>{[job, future = std::move(future)]() -> R {
+        job.try_run();
+        current_wait_policy().wait(future);
+        return future.get();
+    }};
+}
+
+/*
+ * A shared_task remembers its first outcome, failure included, so there is nothing to retry once it is shared.
+ * Retry the packaged_task before sharing it instead: task | retry(policy) | share().
+ */
+template<typename Signature>
+shared_task<Signature> operator|(shared_task<Signature> task, Retry) = delete;
+
+}
@@ -0,0 +1,245 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/executor.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace sib::monad {
+
+/*
+ * scope is a nursery for parallel work.
+ * While a scope is alive, every operand spawned on the thread that created it (e.g. by a parallel when_any or
+ * when_all, or | start()) is tracked, as is anything those operands spawn in turn.
+ * Threads started for that work (when there is no executor) belong to the scope, and are joined rather than detached.
+ *
+ * join() waits for all the tracked work; cancel() drops any of it that has not started yet.
+ * The destructor joins, cancelling first if constructed with on_exit::cancel.
+ * Do not join a scope from work that it tracks.
+ */
+class scope
+{
+public:
+    enum class on_exit : bool { join, cancel };
+
+private:
+    class State : public tracker
+    {
+    public:
+        mutable std::mutex mutex;
+        std::condition_variable idle;
+        std::size_t in_flight = 0;
+        std::atomic<bool> stop{false};
+
+        struct Launched
+        {
+            std::thread thread;
+            std::shared_ptr<std::atomic<bool>> done;
+        };
+        std::vector<Launched> threads;
+
+        // Joins a thread, or detaches it if it cannot be joined (e.g. it is the calling thread),
+        // so that it is never destroyed while joinable.
+        static void finish(std::thread& thread) noexcept
+        {
+            if (thread.get_id() != std::this_thread::get_id()) {
+                try {
+                    thread.join();
+                    return;
+                } catch (std::system_error const&) {
+                }
+            }
+            thread.detach();
+        }
+
+        // Removes the threads whose jobs have finished, for the caller to join outside the lock.
+        std::vector<Launched> reap()
+        {
+            auto const finished = std::partition(threads.begin(), threads.end(), [](Launched const& l) {
+                return !l.done->load(std::memory_order_acquire);
+            });
+            std::vector<Launched> result{std::make_move_iterator(finished), std::make_move_iterator(threads.end())};
+            threads.erase(finished, threads.end());
+            return result;
+        }
+
+        // Counts a job in flight for as long as it (or a copy of it) exists.
+        class Token
+        {
+        private:
+            std::shared_ptr<State> state;
+
+        public:
+            explicit Token(std::shared_ptr<State> s) :
+                state{std::move(s)}
+            {
+                std::lock_guard<std::mutex> const lock{state->mutex};
+                ++state->in_flight;
+            }
+
+            Token(Token const&) = delete;
+            Token& operator=(Token const&) = delete;
+
+            ~Token() noexcept
+            {
+                std::lock_guard<std::mutex> const lock{state->mutex};
+                if (--state->in_flight == 0) {
+                    state->idle.notify_all();
+                }
+            }
+
+            State* get() const noexcept
+            {
+                return state.get();
+            }
+        };
+
+        std::weak_ptr<State> self;
+
+        std::function<void()> track(std::function<void()> job) override
+        {
+            return [token = std::make_shared<Token>(self.lock()), job = std::move(job)] {
+                auto* const state = token->get();
+                if (!state->cancelled()) {
+                    // Work spawned by this job belongs to the scope too.
+                    tracker::scope const tracked{state};
+                    job();
+                }
+            };
+        }
+
+        // Each launch joins the threads that have finished since the last, so a long-lived scope holds only those
+        // that are still running.
+        void launch(std::function<void()> job) override
+        {
+            auto done = std::make_shared<std::atomic<bool>>(false);
+            std::vector<Launched> finished;
+            {
+                std::lock_guard<std::mutex> const lock{mutex};
+                finished = reap();
+                threads.push_back({std::thread{[job = std::move(job), done] {
+                    job();
+                    done->store(true, std::memory_order_release);
+                }}, done});
+            }
+            for (auto& l : finished) {
+                finish(l.thread);
+            }
+        }
+
+        bool cancelled() const noexcept override
+        {
+            return stop.load(std::memory_order_relaxed);
+        }
+    };
+
+    std::shared_ptr<State> state;
+    on_exit exit;
+    tracker::scope current;
+
+    static std::shared_ptr<State> make_state()
+    {
+        auto result = std::make_shared<State>();
+        result->self = result;
+        return result;
+    }
+
+public:
+    explicit scope(on_exit exit = on_exit::join) :
+        state{make_state()},
+        exit{exit},
+        current{state.get()}
+    {}
+
+    scope(scope const&) = delete;
+    scope& operator=(scope const&) = delete;
+
+    ~scope() noexcept
+    {
+        if (exit == on_exit::cancel) {
+            cancel();
+        }
+        try {
+            join();
+        } catch (std::system_error const&) {
+            // Waiting failed, so the work still in flight keeps the state alive, and its threads are left to finish.
+            std::lock_guard<std::mutex> const lock{state->mutex};
+            for (auto& l : state->threads) {
+                l.thread.detach();
+            }
+            state->threads.clear();
+        }
+    }
+
+    /*
+     * Waits for all the tracked work to finish, and joins the scope's threads.
+     * A thread that cannot be joined (e.g. because join was called from it, against the advice above) is detached.
+     */
+    void join()
+    {
+        std::vector<State::Launched> threads;
+        {
+            std::unique_lock<std::mutex> lock{state->mutex};
+            state->idle.wait(lock, [this] { return state->in_flight == 0; });
+            threads.swap(state->threads);
+        }
+        for (auto& l : threads) {
+            State::finish(l.thread);
+        }
+    }
+
+    /*
+     * Tracked work that has not started yet will not run.  Work that is running may poll cancellation_requested().
+     */
+    void cancel() noexcept
+    {
+        state->stop = true;
+    }
+
+    bool cancelled() const noexcept
+    {
+        return state->cancelled();
+    }
+
+    /*
+     * The number of tracked jobs that have not yet finished (or been dropped).
+     */
+    std::size_t in_flight() const
+    {
+        std::lock_guard<std::mutex> const lock{state->mutex};
+        return state->in_flight;
+    }
+
+    /*
+     * The number of threads started for tracked work that the scope has not yet joined.
+     * Finished threads are joined when the next is started, so this is bounded by the work running at that time.
+     */
+    std::size_t threads() const
+    {
+        std::lock_guard<std::mutex> const lock{state->mutex};
+        return state->threads.size();
+    }
+
+    /*
+     * Whether the scope tracking the calling job has been cancelled.
+     */
+    static bool cancellation_requested() noexcept
+    {
+        auto const* t = tracker::current();
+        return t && t->cancelled();
+    }
+};
+
+}
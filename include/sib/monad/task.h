@@ -6,8 +6,23 @@
 #pragma once
 
 #include "sib/monad/monad.h"
+#include "sib/affinity.h"
+#include "sib/batch_task.h"
+#include "sib/cost_model.h"
+#include "sib/executor.h"
+#include "sib/race.h"
 #include "sib/shared_task.h"
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <utility>
+#include <variant>
 
 namespace sib::monad {
 
@@ -39,6 +54,30 @@ R operator|(shared_task<R(Args...)> const& task, Get<GArgs...> const& g)
     return task.get_future().get();
 }
 
+/*
+ * task | get_with(policy, args...) is task | get(args...), but waits on this thread follow the given wait_policy.
+ */
+template<typename... Args>
+struct GetWith
+{
+    wait_policy policy;
+    Get<Args...> g;
+};
+static inline constexpr struct {
+    template<typename... Args>
+    GetWith<Args...> operator()(wait_policy policy, Args&&... args) const
+    {
+        return GetWith<Args...>{std::move(policy), get(std::forward<Args>(args)...)};
+    }
+} get_with;
+
+template<typename Task, typename... GArgs>
+auto operator|(Task&& task, GetWith<GArgs...> g) -> decltype(std::forward<Task>(task) | std::move(g.g))
+{
+    wait_policy::scope const scope{std::move(g.policy)};
+    return std::forward<Task>(task) | std::move(g.g);
+}
+
 template<typename Signature>
 std::packaged_task<Signature> operator|(std::packaged_task<Signature> task, Flatten)
 {
@@ -94,7 +133,7 @@ auto operator|(std::packaged_task<R(Args...)> task, Then<Invocable> f)
             auto& task = *task_ptr;
             auto& f = *then_ptr;
 #else
-        [task = std::move(task), f = std::move(f)] mutable (Args... args) {
+        [task = std::move(task), f = std::move(f)](Args... args) mutable {
 #endif
             return std::move(f)(std::move(task) | get(std::move(args)...));
         }
@@ -112,48 +151,403 @@ auto operator|(shared_task<R(Args...)> task, Then<Invocable> f)
     } | flatten();
 }
 
+/*
+ * task | on(placement{node}) runs task near the given NUMA node, wherever it is invoked from.
+ * This lets each operand of a parallel when_all run near its own data.
+ *
+ * If the current executor places work by node (e.g. a numa_executor), the task is submitted there with the placement,
+ * unless the calling thread is already one of that node's workers, and the caller waits for it.
+ * If the submitted job is dropped unrun (e.g. by a cancelled scope), the task's promise is broken.
+ * Otherwise, the calling thread is pinned to the node while the task runs.
+ */
+class On
+{
+public:
+    placement where;
+};
+static inline constexpr struct {
+    On operator()(placement where) const
+    {
+        return On{where};
+    }
+} on;
+
 template<typename R, typename... Args>
-When<std::packaged_task<R(Args...)>> operator^(When<std::packaged_task<R(Args...)>> lhs, std::packaged_task<R(Args...)> rhs) {
-    return {lhs.manner,
-        std::packaged_task<R(Args...)>{
+std::packaged_task<R(Args...)> operator|(std::packaged_task<R(Args...)> task, On o)
+{
+    return std::packaged_task<R(Args...)>{
+#ifdef _MSC_VER
+        // Capture by shared_ptr to work round bug in MSVC where packaged_task can't construct from a mutable lambda.
+        // See https://github.com/microsoft/STL/issues/321
+        [ptr = std::make_shared<decltype(task)>(std::move(task)), o](Args... args) {
+            auto& task = *ptr;
+#else
+        [task = std::move(task), o](Args... args) mutable {
+#endif
+            auto* const exec = executor::current();
+            auto const near = exec ? exec->near(o.where) : executor::nearness::unplaced;
+            if (near == executor::nearness::here) {
+                return std::move(task) | get(std::move(args)...);
+            }
+            if (near == executor::nearness::unplaced) {
+                affinity::node_scope const pinned{o.where.node};
+                return std::move(task) | get(std::move(args)...);
+            }
+            // The job owns the task and its arguments.  If the job is dropped unrun (e.g. by a cancelled scope),
+            // destroying it breaks the task's promise, so the wait ends and get() throws.
+            auto future = task.get_future();
+            spawn([task = std::move(task), args = std::make_tuple(std::move(args)...)]() mutable {
+                std::apply(task, std::move(args));
+            }, o.where);
+            current_wait_policy().wait(future);
+            return future.get();
+        }
+    };
+}
+
+template<typename R, typename... Args>
+std::packaged_task<R(Args...)> operator|(shared_task<R(Args...)> task, On o)
+{
+    return (std::move(task) | then(identity)) | o;
+}
+
+/*
+ * task | at(priority) runs task, and any parallel work it spawns, at the given priority.
+ */
+class At
+{
+public:
+    priority level;
+};
+static inline constexpr struct {
+    At operator()(priority level) const
+    {
+        return At{level};
+    }
+} at;
+
+template<typename R, typename... Args>
+std::packaged_task<R(Args...)> operator|(std::packaged_task<R(Args...)> task, At a)
+{
+    return std::packaged_task<R(Args...)>{
+#ifdef _MSC_VER
+        // Capture by shared_ptr to work round bug in MSVC where packaged_task can't construct from a mutable lambda.
+        // See https://github.com/microsoft/STL/issues/321
+        [ptr = std::make_shared<decltype(task)>(std::move(task)), a](Args... args) {
+            auto& task = *ptr;
+#else
+        [task = std::move(task), a](Args... args) mutable {
+#endif
+            priority_scope const level{a.level};
+            return std::move(task) | get(std::move(args)...);
+        }
+    };
+}
+
+template<typename R, typename... Args>
+std::packaged_task<R(Args...)> operator|(shared_task<R(Args...)> task, At a)
+{
+    return (std::move(task) | then(identity)) | a;
+}
+
+/*
+ * task | start(args...) submits task to the current executor at once, rather than waiting to be called.
+ * It returns a shared_task<R()> for the result, which supports then, get and further combination as usual.
+ * Getting the result runs the task on the calling thread if nobody has started it yet.
+ */
+template<typename... Args>
+struct Start
+{
+    std::tuple<Args...> args;
+};
+static inline constexpr struct {
+    template<typename... Args>
+    Start<std::decay_t<Args>...> operator()(Args&&... args) const
+    {
+        return Start<std::decay_t<Args>...>{{std::forward<Args>(args)...}};
+    }
+} start;
+
+template<typename R, typename... Args, typename... SArgs>
+shared_task<R()> operator|(std::packaged_task<R(Args...)> task, Start<SArgs...> s)
+{
+    auto future = task.get_future().share();
+    auto const job = spawn([task = std::move(task), args = std::move(s.args)]() mutable {
+        std::apply(task, std::move(args));
+    });
+    return shared_task<R()>{[job, future = std::move(future)]() -> R {
+        job.try_run();
+        current_wait_policy().wait(future);
+        return future.get();
+    }};
+}
+
+template<typename R, typename... Args, typename... SArgs>
+shared_task<R()> operator|(shared_task<R(Args...)> task, Start<SArgs...> s)
+{
+    return (std::move(task) | then(identity)) | std::move(s);
+}
+
+namespace detail {
+
+// Keys under which in::automatic keeps the cost of each combinator, per signature.
+struct AnyOf;
+struct AllOf;
+// when_any's signature is the same however many operands it has, or however deeply a chain of ^ nests it,
+// so both are part of its key.
+template<typename Combinator, typename Signature, std::size_t Operands = 0, std::size_t Depth = 0>
+struct CostKey {};
+
+// The key for N-operand when_any at the given depth.  Chains nested deeper than the table share its last key.
+template<typename Signature, std::size_t N, std::size_t... Depths>
+std::type_index any_of_key(std::size_t depth, std::index_sequence<Depths...>)
+{
+    static std::type_index const keys[] = {typeid(CostKey<AnyOf, Signature, N, Depths>)...};
+    return keys[std::min(depth, sizeof...(Depths) - 1)];
+}
+
+using cost_clock = std::chrono::steady_clock;
+
+inline std::chrono::nanoseconds since(cost_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(cost_clock::now() - start);
+}
+
+// The cost model that in::automatic consults, or nullptr for a fixed manner.
+inline cost_model* model_for(in manner)
+{
+    return manner == in::automatic ? &cost_model::current() : nullptr;
+}
+
+inline bool run_in_parallel(in manner, cost_model* model, std::type_index key)
+{
+    return model ? model->parallel(key) : manner == in::parallel;
+}
+
+struct Timing
+{
+    cost_clock::time_point start;
+    std::chrono::nanoseconds cost;
+};
+
+// Records the time from start to the end of its scope, if there is a model.
+class Recorder
+{
+private:
+    cost_model* model;
+    std::type_index key;
+    cost_clock::time_point start;
+
+public:
+    Recorder(cost_model* model, std::type_index key) :
+        model{model},
+        key{key},
+        start{model ? cost_clock::now() : cost_clock::time_point{}}
+    {}
+
+    Recorder(Recorder const&) = delete;
+    Recorder& operator=(Recorder const&) = delete;
+
+    ~Recorder() noexcept
+    {
+        if (model) {
+            try {
+                model->record(key, since(start));
+            } catch (...) {}
+        }
+    }
+};
+
+}
+
+namespace detail {
+
+template<typename R>
+using AnyResult = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+/*
+ * What a parallel when_any knows of its operands, shared with their jobs (which may outlive it).
+ * Each job keeps its own operand's outcome.  The first to succeed wins the race; if all fail, the last to fail does,
+ * so that the caller always wakes.
+ * If timed, each job also publishes its start and cost through its status, for the cost model.
+ */
+template<typename R, std::size_t N>
+class AnyOfState
+{
+private:
+    enum status_t : std::uint8_t { waiting, running, succeeded, failed };
+
+    bool const timed;
+    std::atomic<std::size_t> failures{0};
+    std::array<std::atomic<std::uint8_t>, N> status{};
+    std::array<cost_clock::time_point, N> starts{};
+    std::array<std::chrono::nanoseconds, N> costs{};
+
+public:
+    race first;
+    std::array<std::optional<AnyResult<R>>, N> results;
+    std::array<std::exception_ptr, N> errors;
+
+    explicit AnyOfState(bool timed) :
+        timed{timed}
+    {}
+
+    template<typename Task, typename Arguments>
+    void run(std::size_t i, Task& task, Arguments&& args)
+    {
+        if (timed) {
+            starts[i] = cost_clock::now();
+            status[i].store(running, std::memory_order_release);
+        }
+        auto future = task.get_future();
+        std::apply(task, std::forward<Arguments>(args));
+        bool ok = true;
+        try {
+            if constexpr (std::is_void_v<R>) {
+                future.get();
+                results[i].emplace();
+            } else {
+                results[i].emplace(future.get());
+            }
+        } catch (...) {
+            errors[i] = std::current_exception();
+            ok = false;
+        }
+        if (timed) {
+            costs[i] = since(starts[i]);
+            status[i].store(ok ? succeeded : failed, std::memory_order_release);
+        }
+        if (ok || failures.fetch_add(1, std::memory_order_acq_rel) + 1 == N) {
+            first.finish(static_cast<std::uint32_t>(i));
+        }
+    }
+
+    /*
+     * How long the operands would have taken in sequence: each in turn, until one succeeds.
+     * Unknown (rather than underestimated by the winner's time) while any operand that would have run is unfinished.
+     */
+    std::optional<std::chrono::nanoseconds> sequential_cost() const
+    {
+        std::chrono::nanoseconds total{0};
+        for (std::size_t i = 0; i < N; ++i) {
+            auto const s = status[i].load(std::memory_order_acquire);
+            if (s != succeeded && s != failed) {
+                return std::nullopt;
+            }
+            total += costs[i];
+            if (s == succeeded) {
+                return total;
+            }
+        }
+        return total;
+    }
+};
+
+/*
+ * when_any over N tasks of one signature, as a single task.
+ * In sequence, it runs each in turn until one succeeds.  In parallel, it spawns them all and waits on one race.
+ */
+template<typename Signature, std::size_t N>
+class AnyOfTasks;
+
+template<typename R, typename... Args, std::size_t N>
+class AnyOfTasks<R(Args...), N>
+{
+private:
+    using Tasks = std::array<std::packaged_task<R(Args...)>, N>;
+
+    static R in_sequence(Tasks& tasks, Args&... args)
+    {
+        for (std::size_t i = 0; i + 1 < N; ++i) {
+            try {
+                return std::move(tasks[i]) | get(args...);
+            } catch (...) {}
+        }
+        return std::move(tasks[N - 1]) | get(std::move(args)...);
+    }
+
+    static R in_parallel(Tasks& tasks, Args&... args, cost_model* model, std::type_index key)
+    {
+        auto const state = std::make_shared<AnyOfState<R, N>>(model != nullptr);
+        std::array<std::optional<spawned>, N> jobs;
+        for (std::size_t i = 0; i < N; ++i) {
+            jobs[i] = spawn([state, i, task = std::move(tasks[i]), args = std::make_tuple(args...)]() mutable {
+                state->run(i, task, std::move(args));
+            });
+        }
+
+        // If no operand has started, the executor may be saturated (possibly by our own callers).
+        // Rather than risk deadlock, run them here until there is a winner.  After that, either there is one, or
+        // every operand is running elsewhere, so one will finish: block until it does.
+        auto const finished = [&state] { return state->first.first().has_value(); };
+        if (!current_wait_policy().spin_until(finished)) {
+            if (auto* const s = suspender::current()) {
+                // Other fibers, including our operands, run while this one is suspended.
+                s->suspend_until(finished);
+            } else {
+                for (auto& job : jobs) {
+                    if (finished()) {
+                        break;
+                    }
+                    job->try_run();
+                }
+            }
+        }
+        auto const index = state->first.wait();
+
+        if (model) {
+            if (auto const cost = state->sequential_cost()) {
+                model->record(key, *cost);
+            }
+        }
+        auto& result = state->results[index];
+        if (!result) {
+            std::rethrow_exception(state->errors[index]);
+        }
+        // Once the winner has succeeded, the others are not needed: drop any that have not started.
+        for (auto& job : jobs) {
+            job->try_cancel();
+        }
+        if constexpr (!std::is_void_v<R>) {
+            return std::move(*result);
+        }
+    }
+
+public:
+    static std::packaged_task<R(Args...)> make(in manner, Tasks tasks, std::size_t depth = 0)
+    {
+        return std::packaged_task<R(Args...)>{
 #ifdef _MSC_VER
             // Capture by shared_ptr to work round bug in MSVC where packaged_task can't construct from a mutable lambda.
             // See https://github.com/microsoft/STL/issues/321
-            [manner = lhs.manner,
-             lptr = std::make_shared<decltype(lhs.value)>(std::move(lhs.value)),
-             rptr = std::make_shared<decltype(rhs)>(std::move(rhs))](Args... args) {
-                auto& lhs = *lptr;
-                auto& rhs = *rptr;
+            [manner, depth, ptr = std::make_shared<Tasks>(std::move(tasks))](Args... args) {
+                auto& tasks = *ptr;
 #else
-            [manner = lhs.manner, lhs = std::move(lhs.value), rhs = std::move(rhs)](Args... args) mutable {
+            [manner, depth, tasks = std::move(tasks)](Args... args) mutable {
 #endif
-                if (manner == in::sequence) {
-                    try {
-                        return std::move(lhs) | get(args...);
-                    } catch (...) {}
-                    return std::move(rhs) | get(args...);
-                } else {
-                    std::array<std::future<R>, 2> futures = {lhs.get_future(), rhs.get_future()};
-                    shared_task<std::size_t(std::size_t)> const first{[](auto x) { return x; }};
-
-                    std::thread{[lhs = std::move(lhs), first = first](Args... args) mutable {
-                        lhs(std::move(args)...);
-                        first(0);
-                    }, args...}.detach();
-                    std::thread{[rhs = std::move(rhs), first = first](Args... args) mutable {
-                        rhs(std::move(args)...);
-                        first(1);
-                    }, args...}.detach();
-
-                    auto const index = first.get_future().get();
-                    try {
-                        return futures[index].get();
-                    } catch (...) {}
-                    return futures[1 - index].get();
+                auto* const model = model_for(manner);
+                auto const key = any_of_key<R(Args...), N>(depth, std::make_index_sequence<16>{});
+                if (!run_in_parallel(manner, model, key)) {
+                    Recorder const recorder{model, key};
+                    return in_sequence(tasks, args...);
                 }
+                return in_parallel(tasks, args..., model, key);
             }
-        }
-    };
+        };
+    }
+};
+
+}
+
+/*
+ * Each operator^ makes a task that, in parallel, spawns both its operands, so a chain of them nests: a parallel lhs
+ * occupies a thread of its own while it waits.  when_any over tasks (below) spawns each operand once instead.
+ */
+template<typename R, typename... Args>
+When<std::packaged_task<R(Args...)>> operator^(When<std::packaged_task<R(Args...)>> lhs, std::packaged_task<R(Args...)> rhs) {
+    return {lhs.manner,
+            detail::AnyOfTasks<R(Args...), 2>::make(lhs.manner, {std::move(lhs.value), std::move(rhs)}, lhs.depth),
+            lhs.depth + 1};
 }
 
 template<typename R, typename... Args>
@@ -185,17 +579,41 @@ When<std::packaged_task<std::tuple<Ls..., R>(LArgs..., RArgs...)>>
 #else
             [manner = lhs.manner, lhs = std::move(lhs.value), rhs = std::move(rhs)](LArgs... largs, RArgs... rargs) mutable {
 #endif
-                if (manner == in::sequence) {
+                auto* const model = detail::model_for(manner);
+                std::type_index const key = typeid(detail::CostKey<detail::AllOf, std::tuple<Ls..., R>(LArgs..., RArgs...)>);
+                if (!detail::run_in_parallel(manner, model, key)) {
+                    detail::Recorder const recorder{model, key};
                     return std::tuple_cat(std::move(lhs) | get(std::move(largs)...),
                                           std::move(rhs) | then(make_tuple) | get(std::move(rargs)...));
                 } else {
-                    auto rhs_as_tuple = std::move(rhs) | then(make_tuple);
-                    auto lfuture = lhs.get_future();
+                    // Spawn rhs, but run lhs on this thread.
+                    // If nobody has started rhs by the time lhs is done, run that here too.
+                    // rhs's cost is measured before its result is published, so it is visible once the result is.
+                    auto const rtime = model ? std::make_shared<detail::Timing>() : nullptr;
+                    auto rhs_as_tuple = std::move(rhs) | then([rtime](auto&& result) {
+                        if (rtime) {
+                            rtime->cost = detail::since(rtime->start);
+                        }
+                        return std::make_tuple(std::forward<decltype(result)>(result));
+                    });
                     auto rfuture = rhs_as_tuple.get_future();
-                    auto lvoid = std::async(std::launch::async, std::move(lhs), std::move(largs)...);
-                    auto rvoid = std::async(std::launch::async, std::move(rhs_as_tuple), std::move(rargs)...);
-                    std::ignore = lvoid, rvoid;
-                    return std::tuple_cat(lfuture.get(), rfuture.get());
+                    auto const rjob = spawn([rhs = std::move(rhs_as_tuple), rtime, rargs = std::make_tuple(std::move(rargs)...)]() mutable {
+                        if (rtime) {
+                            rtime->start = detail::cost_clock::now();
+                        }
+                        std::apply(rhs, std::move(rargs));
+                    });
+                    auto const lstart = detail::cost_clock::now();
+                    auto lresult = std::move(lhs) | get(std::move(largs)...);
+                    auto const lcost = detail::since(lstart);
+                    rjob.try_run();
+                    current_wait_policy().wait(rfuture);
+                    auto rresult = rfuture.get();
+                    if (model) {
+                        // In sequence, the operands would have taken the sum of their times.
+                        model->record(key, lcost + rtime->cost);
+                    }
+                    return std::tuple_cat(std::move(lresult), std::move(rresult));
                 }
             }
         }
@@ -215,4 +633,307 @@ operator&(When<std::packaged_task<std::tuple<Ls...>(LArgs...)>> lhs, shared_task
     return std::move(lhs) & (std::move(rhs) | then(identity));
 }
 
+namespace detail {
+
+template<typename Signature>
+struct TaskSignature;
+
+template<typename R, typename... Args>
+struct TaskSignature<R(Args...)>
+{
+    using result = R;
+    using arguments = std::tuple<Args...>;
+};
+
+template<typename Results, typename Arguments>
+struct JoinSignature;
+
+template<typename Results, typename... Args>
+struct JoinSignature<Results, std::tuple<Args...>>
+{
+    using type = Results(Args...);
+};
+
+// The signature of when_all over tasks of the given signatures: a tuple of their results, taking all their arguments.
+template<typename... Signatures>
+using all_of_signature_t = typename JoinSignature<
+    std::tuple<typename TaskSignature<Signatures>::result...>,
+    decltype(std::tuple_cat(std::declval<typename TaskSignature<Signatures>::arguments>()...))
+>::type;
+
+// A flat tuple: unlike std::tuple, its elements' types do not mention each other, so their names stay short.
+template<std::size_t I, typename T>
+struct Leaf
+{
+    T value;
+};
+
+template<typename Indices, typename... Ts>
+struct Leaves;
+
+template<std::size_t... Is, typename... Ts>
+struct Leaves<std::index_sequence<Is...>, Ts...> : Leaf<Is, Ts>...
+{};
+
+template<std::size_t I, typename T>
+T& leaf(Leaf<I, T>& l) noexcept
+{
+    return l.value;
+}
+
+// Moves the arguments of an operand, which start at Offset, out of everybody's.
+template<typename Own, std::size_t Offset, typename Arguments, std::size_t... As>
+Own slice(Arguments& arguments, std::index_sequence<As...>)
+{
+    return Own{std::get<Offset + As>(std::move(arguments))...};
+}
+
+/*
+ * One operand of when_all over tasks, with its arguments, timed if there is somewhere to put its cost.
+ * It depends on the operand's signature alone, so operands of one signature share its code however many there are.
+ */
+template<typename Signature>
+class AllOfOperand;
+
+template<typename R, typename... Args>
+class AllOfOperand<R(Args...)>
+{
+private:
+    std::packaged_task<R(Args...)> task;
+    std::tuple<Args...> arguments;
+    std::shared_ptr<Timing> timing;
+
+public:
+    AllOfOperand(std::packaged_task<R(Args...)> operand, std::tuple<Args...> args, std::shared_ptr<Timing> time) :
+        task{std::move(operand)},
+        arguments{std::move(args)},
+        timing{std::move(time)}
+    {
+        if (timing) {
+            // The cost is measured before the result is published, so it is visible once the result is.
+            task = std::move(task) | then([timing = timing](R result) {
+                timing->cost = since(timing->start);
+                return result;
+            });
+        }
+    }
+
+    std::future<R> get_future()
+    {
+        return task.get_future();
+    }
+
+    void operator()()
+    {
+        if (timing) {
+            timing->start = cost_clock::now();
+        }
+        std::apply(task, std::move(arguments));
+    }
+
+    static R run(std::packaged_task<R(Args...)>& operand, std::tuple<Args...> args)
+    {
+        AllOfOperand self{std::move(operand), std::move(args), nullptr};
+        auto future = self.get_future();
+        self();
+        return future.get();
+    }
+};
+
+/*
+ * when_all over packaged_tasks, as a single task that runs all of its operands.
+ * A fold over operator& builds a task, of a distinct signature, for each prefix of the operands, so that compile time
+ * and object size grow quadratically with their number.  Here, only this class's few members mention every operand,
+ * and the code for each operand is shared with any others of its signature, so growth is linear.
+ */
+template<typename Signature, typename Indices, typename... Signatures>
+class AllOfTasks;
+
+template<typename... Rs, typename... Args, std::size_t... Is, typename... Signatures>
+class AllOfTasks<std::tuple<Rs...>(Args...), std::index_sequence<Is...>, Signatures...>
+{
+private:
+    using Tuple = std::tuple<Rs...>;
+    using Arguments = std::tuple<Args...>;
+    using Tasks = Leaves<std::index_sequence<Is...>, std::packaged_task<Signatures>...>;
+    static constexpr std::size_t size = sizeof...(Signatures);
+
+    // Where each operand's arguments start among Args.
+    static constexpr std::array<std::size_t, size> offsets()
+    {
+        std::size_t const arities[] = {std::tuple_size_v<typename TaskSignature<Signatures>::arguments>...};
+        std::array<std::size_t, size> result{};
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < size; ++i) {
+            result[i] = total;
+            total += arities[i];
+        }
+        return result;
+    }
+
+    template<typename Signature>
+    using OwnArguments = typename TaskSignature<Signature>::arguments;
+
+    template<typename Signature>
+    using OwnIndices = std::make_index_sequence<std::tuple_size_v<OwnArguments<Signature>>>;
+
+    static Tuple in_sequence(Tasks& tasks, Arguments& arguments)
+    {
+        // The elements of a braced initialiser are evaluated in order, so the operands run in order.
+        return Tuple{AllOfOperand<Signatures>::run(leaf<Is>(tasks),
+            slice<OwnArguments<Signatures>, offsets()[Is]>(arguments, OwnIndices<Signatures>{}))...};
+    }
+
+    static Tuple in_parallel(Tasks& tasks, Arguments& arguments, cost_model* model, std::type_index key)
+    {
+        auto const timings = model ? std::make_shared<std::array<Timing, size>>() : nullptr;
+        Leaves<std::index_sequence<Is...>, AllOfOperand<Signatures>...> operands{{{
+            std::move(leaf<Is>(tasks)),
+            slice<OwnArguments<Signatures>, offsets()[Is]>(arguments, OwnIndices<Signatures>{}),
+            timings ? std::shared_ptr<Timing>{timings, &(*timings)[Is]} : nullptr
+        }}...};
+        Leaves<std::index_sequence<Is...>, std::future<Rs>...> futures{{leaf<Is>(operands).get_future()}...};
+
+        // Spawn every operand but the first, and run that on this thread.
+        // Then run any that nobody has started by the time we need its result.
+        std::array<std::optional<spawned>, size> jobs;
+        ((Is > 0 ? void(jobs[Is] = spawn(std::move(leaf<Is>(operands)))) : void()), ...);
+        leaf<0>(operands)();
+        ((Is > 0 ? void((jobs[Is]->try_run(), current_wait_policy().wait(leaf<Is>(futures)))) : void()), ...);
+
+        if (model) {
+            // In sequence, the operands would have taken the sum of their times.
+            model->record(key, ((*timings)[Is].cost + ...));
+        }
+        return Tuple{leaf<Is>(futures).get()...};
+    }
+
+public:
+    static std::packaged_task<Tuple(Args...)> make(in manner, std::packaged_task<Signatures>... operands)
+    {
+        return std::packaged_task<Tuple(Args...)>{
+#ifdef _MSC_VER
+            // Capture by shared_ptr to work round bug in MSVC where packaged_task can't construct from a mutable lambda.
+            // See https://github.com/microsoft/STL/issues/321
+            [manner, ptr = std::make_shared<Tasks>(Tasks{{std::move(operands)}...})](Args... args) {
+                auto& tasks = *ptr;
+#else
+            [manner, tasks = Tasks{{std::move(operands)}...}](Args... args) mutable {
+#endif
+                auto* const model = model_for(manner);
+                std::type_index const key = typeid(CostKey<AllOf, Tuple(Args...)>);
+                Arguments arguments{std::forward<Args>(args)...};
+                if (!run_in_parallel(manner, model, key)) {
+                    Recorder const recorder{model, key};
+                    return in_sequence(tasks, arguments);
+                }
+                return in_parallel(tasks, arguments, model, key);
+            }
+        };
+    }
+};
+
+}
+
+/*
+ * when_all over packaged_tasks builds one flat task (see detail::AllOfTasks) rather than folding operator&.
+ * In parallel, it spawns every operand but the first, which it runs itself, just as the fold would.
+ */
+template<typename... Signatures>
+struct WhenAll<std::packaged_task<Signatures>...>
+{
+    using Signature = detail::all_of_signature_t<Signatures...>;
+
+    static std::packaged_task<Signature> combine(in manner, std::packaged_task<Signatures>... tasks)
+    {
+        return detail::AllOfTasks<Signature, std::index_sequence_for<Signatures...>, Signatures...>::make(
+            manner, std::move(tasks)...);
+    }
+};
+
+// when_all over shared_tasks waits on each through a packaged_task, as operator& does, then combines those.
+template<typename... Signatures>
+struct WhenAll<shared_task<Signatures>...>
+{
+    static auto combine(in manner, shared_task<Signatures>... tasks)
+    {
+        return WhenAll<std::packaged_task<Signatures>...>::combine(manner, std::move(tasks) | then(identity)...);
+    }
+};
+
+/*
+ * when_any over packaged_tasks of one signature races all of its operands in one task (see detail::AnyOfTasks),
+ * rather than folding operator^.  In parallel, it spawns each operand once, and waits for them on a single race.
+ */
+template<typename R, typename... Args, typename... Tasks>
+struct WhenAny<std::packaged_task<R(Args...)>, Tasks...>
+{
+    static_assert(std::conjunction_v<std::is_same<Tasks, std::packaged_task<R(Args...)>>...>,
+                  "when_any needs operands of one signature");
+
+    static std::packaged_task<R(Args...)> combine(in manner, std::packaged_task<R(Args...)> head, Tasks... tail)
+    {
+        return detail::AnyOfTasks<R(Args...), sizeof...(Tasks) + 1>::make(manner, {std::move(head), std::move(tail)...});
+    }
+};
+
+// when_any over shared_tasks waits on each through a packaged_task, as operator^ does, then races those.
+template<typename R, typename... Args, typename... Tasks>
+struct WhenAny<shared_task<R(Args...)>, Tasks...>
+{
+    static_assert(std::conjunction_v<std::is_same<Tasks, shared_task<R(Args...)>>...>,
+                  "when_any needs operands of one signature");
+
+    static std::packaged_task<R(Args...)> combine(in manner, shared_task<R(Args...)> head, Tasks... tail)
+    {
+        return WhenAny<std::packaged_task<R(Args...)>, std::conditional_t<true, std::packaged_task<R(Args...)>, Tasks>...>::combine(
+            manner, std::move(head) | then(identity), std::move(tail) | then(identity)...);
+    }
+};
+
+/*
+ * A batch_task<R(K)> behaves as a task taking a key: each call loads its key through the next batch.
+ */
+template<typename R, typename K, typename... GArgs>
+R operator|(batch_task<R(K)> const& task, Get<GArgs...> g)
+{
+    return task.load(std::get<0>(std::move(g.args))) | get();
+}
+
+template<typename R, typename K, typename Invocable>
+auto operator|(batch_task<R(K)> task, Then<Invocable> f)
+{
+    using Result = std::invoke_result_t<Invocable, R>;
+    return std::packaged_task<Result(K)> {
+            [task = std::move(task), f = std::move(f)] (K key) {
+                return f(task.load(std::move(key)) | get());
+            }
+    } | flatten();
+}
+
+template<typename R, typename K>
+When<std::packaged_task<R(K)>> operator^(in manner, batch_task<R(K)> task)
+{
+    return manner ^ (std::move(task) | then(identity));
+}
+
+template<typename R, typename K>
+When<std::packaged_task<R(K)>> operator^(When<std::packaged_task<R(K)>> lhs, batch_task<R(K)> rhs)
+{
+    return std::move(lhs) ^ (std::move(rhs) | then(identity));
+}
+
+template<typename R, typename K>
+When<std::packaged_task<std::tuple<R>(K)>> operator&(in manner, batch_task<R(K)> task)
+{
+    return manner & (std::move(task) | then(identity));
+}
+
+template<typename... Ls, typename R, typename... LArgs, typename K>
+When<std::packaged_task<std::tuple<Ls..., R>(LArgs..., K)>>
+operator&(When<std::packaged_task<std::tuple<Ls...>(LArgs...)>> lhs, batch_task<R(K)> rhs)
+{
+    return std::move(lhs) & (std::move(rhs) | then(identity));
+}
+
 }
@@ -0,0 +1,127 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/affinity.h"
+#include "sib/executor.h"
+#include "sib/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sib {
+
+/*
+ * numa_executor owns one group of workers per set of CPUs, each worker pinned to its group's CPUs.
+ * By default there is one group per NUMA node, with one worker per CPU in the node.
+ *
+ * A job placed on node n runs in group n.  Unplaced jobs (and those placed on a group that does not exist)
+ * are spread round-robin across the groups.
+ * Given no groups (e.g. if the NUMA topology cannot be read), it has a single unpinned group, one worker per hardware thread.
+ */
+class numa_executor : public executor {
+private:
+    std::vector<std::unique_ptr<thread_pool>> groups;
+    std::atomic<std::size_t> next;
+
+    // The executor and group that the calling thread works for, if any.
+    static std::pair<numa_executor const*, std::size_t>& group_slot() noexcept
+    {
+        static thread_local std::pair<numa_executor const*, std::size_t> group{nullptr, 0};
+        return group;
+    }
+
+public:
+    explicit numa_executor(std::vector<std::vector<int>> const& cpu_groups = affinity::numa_nodes()) :
+        groups{},
+        next{0}
+    {
+        if (cpu_groups.empty()) {
+            groups.push_back(std::make_unique<thread_pool>(
+                std::max(1u, std::thread::hardware_concurrency()), [this] { group_slot() = {this, 0}; }, this));
+            return;
+        }
+        groups.reserve(cpu_groups.size());
+        for (auto const& cpus : cpu_groups) {
+            groups.push_back(std::make_unique<thread_pool>(
+                std::max<std::size_t>(1, cpus.size()),
+                [this, cpus, group = groups.size()] {
+                    affinity::pin_this_thread(cpus);
+                    group_slot() = {this, group};
+                },
+                this
+            ));
+        }
+    }
+
+    /*
+     * One group per CPU that the calling thread may run on, for per-core placement.
+     */
+    static std::vector<std::vector<int>> cores()
+    {
+        std::vector<std::vector<int>> result;
+        for (auto cpu : affinity::this_thread_cpus()) {
+            result.push_back({cpu});
+        }
+        return result;
+    }
+
+    numa_executor(numa_executor const&) = delete;
+    numa_executor& operator=(numa_executor const&) = delete;
+
+    /*
+     * Runs every job already submitted, including those that jobs submit to other groups, before any group is destroyed.
+     * Once a full pass finds every group idle with no new submissions since the previous pass, every group was idle
+     * at once, so no job remains to submit more.
+     */
+    ~numa_executor() noexcept override
+    {
+        std::vector<std::uint64_t> submitted(groups.size(), std::numeric_limits<std::uint64_t>::max());
+        for (bool settled = false; !settled;) {
+            settled = true;
+            for (std::size_t i = 0; i < groups.size(); ++i) {
+                auto const now = groups[i]->drain();
+                if (now != submitted[i]) {
+                    submitted[i] = now;
+                    settled = false;
+                }
+            }
+        }
+    }
+
+    std::size_t size() const noexcept
+    {
+        return groups.size();
+    }
+
+    using executor::submit;
+
+    nearness near(placement where) const noexcept override
+    {
+        if (where.node < 0 || static_cast<std::size_t>(where.node) >= groups.size()) {
+            return nearness::here;
+        }
+        return group_slot() == std::pair<numa_executor const*, std::size_t>{this, where.node} ?
+            nearness::here :
+            nearness::elsewhere;
+    }
+
+    void submit(std::function<void()> job, placement where) override
+    {
+        auto const group = where.node >= 0 && static_cast<std::size_t>(where.node) < groups.size() ?
+            static_cast<std::size_t>(where.node) :
+            next.fetch_add(1, std::memory_order_relaxed) % groups.size();
+        groups[group]->submit(std::move(job), placement{-1, where.level});
+    }
+};
+
+}
@@ -0,0 +1,353 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/shared_task.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sib {
+
+/*
+ * Whether a trivially copyable T holds addresses, which would be garbage in a later run of the program,
+ * so cannot be stored by copying its bytes.  Specialise it as true for your own types that hold pointers.
+ */
+template<typename T>
+struct holds_addresses : std::bool_constant<std::is_pointer_v<T> || std::is_member_pointer_v<T>> {};
+
+template<typename Char, typename Traits>
+struct holds_addresses<std::basic_string_view<Char, Traits>> : std::true_type {};
+
+/*
+ * How a persistent_cache stores values of type T.  Specialise it for other types, with:
+ *     static void save(T const& value, std::vector<unsigned char>& out);  // appends the value's bytes to out
+ *     static T load(unsigned char const* data, std::size_t size);
+ * Stored bytes may be read back by a later run of the program, so must not contain pointers.
+ */
+template<typename T, typename = void>
+struct serializer;
+
+template<typename T>
+struct serializer<T, std::enable_if_t<std::is_trivially_copyable_v<T>>>
+{
+    static_assert(!holds_addresses<T>::value, "serializer: T holds addresses, which a later run could not use");
+
+    static void save(T const& value, std::vector<unsigned char>& out)
+    {
+        auto const* const bytes = reinterpret_cast<unsigned char const*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    static T load(unsigned char const* data, std::size_t size)
+    {
+        if (size != sizeof(T)) {
+            throw std::length_error{"serializer: stored size does not match the type"};
+        }
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+};
+
+template<typename T, typename Allocator>
+struct serializer<std::vector<T, Allocator>, std::enable_if_t<std::is_trivially_copyable_v<T>>>
+{
+    static_assert(!holds_addresses<T>::value, "serializer: T holds addresses, which a later run could not use");
+
+    static void save(std::vector<T, Allocator> const& value, std::vector<unsigned char>& out)
+    {
+        auto const* const bytes = reinterpret_cast<unsigned char const*>(value.data());
+        out.insert(out.end(), bytes, bytes + value.size() * sizeof(T));
+    }
+
+    static std::vector<T, Allocator> load(unsigned char const* data, std::size_t size)
+    {
+        if (size % sizeof(T) != 0) {
+            throw std::length_error{"serializer: stored size does not match the type"};
+        }
+        std::vector<T, Allocator> value(size / sizeof(T));
+        std::memcpy(value.data(), data, size);
+        return value;
+    }
+};
+
+template<typename Char, typename Traits, typename Allocator>
+struct serializer<std::basic_string<Char, Traits, Allocator>>
+{
+    static void save(std::basic_string<Char, Traits, Allocator> const& value, std::vector<unsigned char>& out)
+    {
+        auto const* const bytes = reinterpret_cast<unsigned char const*>(value.data());
+        out.insert(out.end(), bytes, bytes + value.size() * sizeof(Char));
+    }
+
+    static std::basic_string<Char, Traits, Allocator> load(unsigned char const* data, std::size_t size)
+    {
+        if (size % sizeof(Char) != 0) {
+            throw std::length_error{"serializer: stored size does not match the type"};
+        }
+        std::basic_string<Char, Traits, Allocator> value(size / sizeof(Char), Char{});
+        std::memcpy(value.data(), data, size);
+        return value;
+    }
+};
+
+/*
+ * persistent_cache memoizes the results of expensive, deterministic computations in a memory-mapped file, so that a
+ * later run of the program can map them back in instead of recomputing them.
+ * Each result is identified by a key and a version: bump the version when the computation changes.
+ *
+ * The file is append-only and has a fixed capacity; once it is full, results are still computed and returned, but
+ * not stored.  Values are found again only by a program built with the same compiler (the type is part of the key).
+ * Safe to use from many threads, but only one process may have the file open at once.  POSIX only.
+ *
+ * The file survives the process crashing, but nothing is synced to disk: after an OS crash or power failure, a record
+ * may have been published before its bytes were written, so delete the file.
+ */
+class persistent_cache
+{
+private:
+    static constexpr char magic[8] = {'s', 'i', 'b', 'c', 'a', 'c', 'h', 'e'};
+    static constexpr std::uint64_t format = 1;
+    // Records and values are aligned to this, so that find() can return pointers into the mapping.
+    static constexpr std::size_t alignment = 64;
+
+    struct Header
+    {
+        char magic[8];
+        std::uint64_t format;
+        std::uint64_t used;
+    };
+
+    struct Record
+    {
+        std::uint64_t type;
+        std::uint64_t size;
+        std::uint32_t version;
+        std::uint32_t key_size;
+    };
+
+    struct Entry
+    {
+        std::uint64_t type;
+        std::uint32_t version;
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    int file;
+    std::size_t capacity;
+    unsigned char* mapping;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> index;
+
+    static std::size_t align(std::size_t offset) noexcept
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    // FNV-1a, so that the tag is the same from one run to the next.
+    template<typename T>
+    static std::uint64_t type_tag() noexcept
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (auto const* c = typeid(T).name(); *c; ++c) {
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    Header& header() const noexcept
+    {
+        return *reinterpret_cast<Header*>(mapping);
+    }
+
+    [[noreturn]] static void fail(char const* what)
+    {
+        throw std::system_error{errno, std::generic_category(), what};
+    }
+
+    // Indexes the records already in the file.  Anything after the last complete record is discarded.
+    void load_index()
+    {
+        auto& head = header();
+        if (std::memcmp(head.magic, magic, sizeof(magic)) != 0 || head.format != format ||
+            head.used < align(sizeof(Header)) || head.used > capacity) {
+            std::memcpy(head.magic, magic, sizeof(magic));
+            head.format = format;
+            head.used = align(sizeof(Header));
+            return;
+        }
+
+        std::size_t offset = align(sizeof(Header));
+        while (offset + sizeof(Record) <= head.used) {
+            Record record;
+            std::memcpy(&record, mapping + offset, sizeof(Record));
+            auto const data = align(offset + sizeof(Record) + record.key_size);
+            if (data > head.used || record.size > head.used - data) {
+                break;
+            }
+            std::string key{reinterpret_cast<char const*>(mapping + offset + sizeof(Record)), record.key_size};
+            index[std::move(key)] = {record.type, record.version, data, static_cast<std::size_t>(record.size)};
+            offset = align(data + record.size);
+        }
+        head.used = std::min<std::uint64_t>(offset, head.used);
+    }
+
+    std::optional<Entry> lookup(std::string const& key, std::uint32_t version, std::uint64_t type) const
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        auto const entry = index.find(key);
+        if (entry == index.end() || entry->second.version != version || entry->second.type != type) {
+            return std::nullopt;
+        }
+        return entry->second;
+    }
+
+    // Appends a record, or does nothing if there is no room for it.
+    void store(std::string const& key, std::uint32_t version, std::uint64_t type, std::vector<unsigned char> const& bytes)
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        auto& head = header();
+        auto const offset = static_cast<std::size_t>(head.used);
+        auto const data = align(offset + sizeof(Record) + key.size());
+        if (data > capacity || bytes.size() > capacity - data) {
+            return;
+        }
+
+        Record const record{type, bytes.size(), version, static_cast<std::uint32_t>(key.size())};
+        std::memcpy(mapping + offset, &record, sizeof(Record));
+        std::memcpy(mapping + offset + sizeof(Record), key.data(), key.size());
+        std::memcpy(mapping + data, bytes.data(), bytes.size());
+        // Publish the record only once it is complete, so that if the process dies, the file is still consistent.
+        // Nothing orders the mapping's pages on their way to disk, so this does not hold if the OS crashes or power
+        // fails (see the class comment).
+        head.used = align(data + bytes.size());
+        index[key] = {type, version, data, bytes.size()};
+    }
+
+public:
+    /*
+     * Opens (or creates) the cache file at path, and maps capacity bytes of it, or the whole file if that is larger.
+     * Throws std::system_error if the file cannot be opened or mapped.
+     */
+    explicit persistent_cache(std::string const& path, std::size_t capacity = 64 * 1024 * 1024) :
+        file{::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)},
+        capacity{0},
+        mapping{nullptr}
+    {
+        if (file < 0) {
+            fail("persistent_cache: open");
+        }
+        struct stat status{};
+        if (::fstat(file, &status) != 0) {
+            ::close(file);
+            fail("persistent_cache: fstat");
+        }
+        this->capacity = std::max({align(capacity), align(sizeof(Header)), static_cast<std::size_t>(status.st_size)});
+        if (static_cast<std::size_t>(status.st_size) < this->capacity &&
+            ::ftruncate(file, static_cast<off_t>(this->capacity)) != 0) {
+            ::close(file);
+            fail("persistent_cache: ftruncate");
+        }
+        auto* const mapped = ::mmap(nullptr, this->capacity, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(file);
+            fail("persistent_cache: mmap");
+        }
+        mapping = static_cast<unsigned char*>(mapped);
+        load_index();
+    }
+
+    persistent_cache(persistent_cache const&) = delete;
+    persistent_cache& operator=(persistent_cache const&) = delete;
+
+    ~persistent_cache() noexcept
+    {
+        ::msync(mapping, capacity, MS_SYNC);
+        ::munmap(mapping, capacity);
+        ::close(file);
+    }
+
+    /*
+     * Returns a task that calls compute() at most once: if a result for (key, version) is already stored, the task
+     * returns that instead, and otherwise it stores what compute() returns.  The result type must have a serializer.
+     * The task must not be called once the cache has been destroyed.
+     */
+    template<typename Callable>
+    auto memoize(std::string key, std::uint32_t version, Callable&& compute)
+    {
+        using R = std::decay_t<std::invoke_result_t<Callable&>>;
+        return shared_task<R()>{
+            [this, key = std::move(key), version, compute = std::forward<Callable>(compute)]() mutable -> R {
+                if (auto const entry = lookup(key, version, type_tag<R>())) {
+                    return serializer<R>::load(mapping + entry->offset, entry->size);
+                }
+                auto result = compute();
+                std::vector<unsigned char> bytes;
+                serializer<R>::save(result, bytes);
+                store(key, version, type_tag<R>(), bytes);
+                return result;
+            }
+        };
+    }
+
+    /*
+     * A pointer straight into the mapping, without copying, to the stored value for (key, version); or nullptr.
+     * It remains valid for the lifetime of the cache.
+     */
+    template<typename T>
+    T const* find(std::string const& key, std::uint32_t version) const
+    {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= alignment,
+                      "find() can only return trivially copyable types in place");
+        static_assert(!holds_addresses<T>::value, "find() cannot return types that hold addresses");
+        auto const entry = lookup(key, version, type_tag<T>());
+        if (!entry || entry->size != sizeof(T)) {
+            return nullptr;
+        }
+        return reinterpret_cast<T const*>(mapping + entry->offset);
+    }
+
+    /*
+     * The bytes of the file in use, including those of superseded results.
+     */
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        return static_cast<std::size_t>(header().used);
+    }
+
+    /*
+     * Writes stored results through to the file now, rather than when the cache is destroyed.
+     */
+    void flush() const
+    {
+        if (::msync(mapping, capacity, MS_SYNC) != 0) {
+            fail("persistent_cache: msync");
+        }
+    }
+};
+
+}
@@ -0,0 +1,167 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <thread>
+
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace sib {
+
+/*
+ * Tells the processor that we are busy-waiting.
+ */
+inline void cpu_relax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+/*
+ * race publishes which of several contenders finished first, as a single atomic word.
+ * The first call to finish wins; a waiter is woken (at most once) only if it has actually gone to sleep.
+ *
+ * On Linux, waiters park on a futex on the word itself.  Elsewhere, they use a mutex and condition variable.
+ */
+class race
+{
+private:
+    static constexpr std::uint32_t none = UINT32_MAX;
+
+    std::atomic<std::uint32_t> winner{none};
+    mutable std::atomic<std::uint32_t> sleepers{0};
+
+#ifdef __linux__
+    std::uint32_t* word() const noexcept
+    {
+        static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+        return reinterpret_cast<std::uint32_t*>(const_cast<std::atomic<std::uint32_t>*>(&winner));
+    }
+
+    void park(timespec const* timeout) const noexcept
+    {
+        syscall(SYS_futex, word(), FUTEX_WAIT_PRIVATE, none, timeout, nullptr, 0);
+    }
+
+    void wake() const noexcept
+    {
+        syscall(SYS_futex, word(), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+#else
+    mutable std::mutex mutex;
+    mutable std::condition_variable finished;
+#endif
+
+    std::optional<std::uint32_t> spin(std::size_t iterations) const noexcept
+    {
+        for (std::size_t i = 0; i < iterations; ++i) {
+            if (auto const w = winner.load(std::memory_order_acquire); w != none) {
+                return w;
+            }
+            cpu_relax();
+        }
+        return std::nullopt;
+    }
+
+public:
+    race() = default;
+    race(race const&) = delete;
+    race& operator=(race const&) = delete;
+
+    /*
+     * Returns true if contender is the first to finish.
+     */
+    bool finish(std::uint32_t contender) noexcept
+    {
+        auto expected = none;
+        if (!winner.compare_exchange_strong(expected, contender, std::memory_order_seq_cst)) {
+            return false;
+        }
+        if (sleepers.load(std::memory_order_seq_cst) != 0) {
+#ifdef __linux__
+            wake();
+#else
+            std::lock_guard<std::mutex> const lock{mutex};
+            finished.notify_all();
+#endif
+        }
+        return true;
+    }
+
+    std::optional<std::uint32_t> first() const noexcept
+    {
+        auto const w = winner.load(std::memory_order_acquire);
+        return w == none ? std::nullopt : std::optional<std::uint32_t>{w};
+    }
+
+    /*
+     * Waits up to timeout for a winner, spinning for up to spin_iterations before parking.
+     */
+    template<typename Rep, typename Period>
+    std::optional<std::uint32_t> wait_for(std::chrono::duration<Rep, Period> timeout, std::size_t spin_iterations = 0) const noexcept
+    {
+        if (auto const w = spin(spin_iterations)) {
+            return w;
+        }
+
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        // Re-check after announcing ourselves, so that a finish in between cannot be missed.
+        if (winner.load(std::memory_order_seq_cst) == none) {
+#ifdef __linux__
+            auto const nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+            timespec const relative{static_cast<std::time_t>(nanoseconds / 1000000000), static_cast<long>(nanoseconds % 1000000000)};
+            park(&relative);
+#else
+            std::unique_lock<std::mutex> lock{mutex};
+            finished.wait_for(lock, timeout, [this] { return winner.load(std::memory_order_acquire) != none; });
+#endif
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return first();
+    }
+
+    /*
+     * Waits for a winner, spinning for up to spin_iterations before parking.
+     */
+    std::uint32_t wait(std::size_t spin_iterations = 0) const noexcept
+    {
+        if (auto const w = spin(spin_iterations)) {
+            return *w;
+        }
+
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        for (auto w = winner.load(std::memory_order_seq_cst); w == none; w = winner.load(std::memory_order_seq_cst)) {
+#ifdef __linux__
+            park(nullptr);
+#else
+            std::unique_lock<std::mutex> lock{mutex};
+            finished.wait(lock, [this] { return winner.load(std::memory_order_acquire) != none; });
+#endif
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return winner.load(std::memory_order_acquire);
+    }
+};
+
+}
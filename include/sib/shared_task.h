@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "sib/executor.h"
 #include <atomic>
 #include <future>
 #include <type_traits>
@@ -71,7 +72,7 @@ public:
     /*
      * ... but EXPLICIT from anything else (e.g. a lambda, std::function etc.)
      */
-    template<typename Callable>
+    template<typename Callable, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, shared_task>>>
     explicit shared_task(Callable&& callable) :
         impl{nullptr}
     {
@@ -97,12 +98,12 @@ public:
      * But subsequent calls (including from other threads) will reuse the same value from before
      * - even if different arguments are supplied.
      *
-     * In either case, the call will not return until the future is ready.
+     * In either case, the call will not return until the future is ready, waiting according to current_wait_policy().
      */
     void operator()(Args... args) const
     {
         if (impl->flag.test_and_set()) {
-            impl->future.wait();
+            current_wait_policy().wait(impl->future);
         } else {
             impl->task(std::move(args)...);
         }
@@ -0,0 +1,112 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace sib {
+
+/*
+ * spsc_queue is a bounded, lock-free ring buffer for exactly one producer thread and one consumer thread.
+ * The producer only ever writes tail and the consumer only ever writes head, so each index lives on its own
+ * cache line and neither side needs a read-modify-write operation.
+ */
+template<typename T>
+class spsc_queue {
+private:
+    static constexpr std::size_t cache_line = 64;
+
+    // One slot is always left empty, so that head == tail unambiguously means empty.
+    std::size_t const slots;
+    std::unique_ptr<std::optional<T>[]> const buffer;
+
+    alignas(cache_line) std::atomic<std::size_t> head;
+    alignas(cache_line) std::atomic<std::size_t> tail;
+
+    std::size_t next(std::size_t index) const noexcept
+    {
+        return index + 1 == slots ? 0 : index + 1;
+    }
+
+public:
+    explicit spsc_queue(std::size_t capacity) :
+        slots{capacity + 1},
+        buffer{std::make_unique<std::optional<T>[]>(capacity + 1)},
+        head{0},
+        tail{0}
+    {}
+
+    spsc_queue(spsc_queue const&) = delete;
+    spsc_queue& operator=(spsc_queue const&) = delete;
+
+    std::size_t capacity() const noexcept
+    {
+        return slots - 1;
+    }
+
+    /*
+     * Producer only.
+     * Returns false (leaving value untouched) if the queue is full.
+     */
+    template<typename U>
+    bool try_push(U&& value)
+    {
+        auto const t = tail.load(std::memory_order_relaxed);
+        auto const n = next(t);
+        if (n == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        buffer[t].emplace(std::forward<U>(value));
+        tail.store(n, std::memory_order_release);
+        return true;
+    }
+
+    /*
+     * Consumer only.
+     * Returns std::nullopt if the queue is empty.
+     */
+    std::optional<T> try_pop()
+    {
+        auto const h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        std::optional<T> result{std::move(buffer[h])};
+        buffer[h].reset();
+        head.store(next(h), std::memory_order_release);
+        return result;
+    }
+
+    /*
+     * Blocking versions of the above.
+     * These spin (yielding the processor) rather than park, since pipeline stages are expected to be busy.
+     */
+    template<typename U>
+    void push(U&& value)
+    {
+        while (!try_push(std::forward<U>(value))) {
+            std::this_thread::yield();
+        }
+    }
+
+    T pop()
+    {
+        for (;;) {
+            if (auto result = try_pop()) {
+                return std::move(*result);
+            }
+            std::this_thread::yield();
+        }
+    }
+};
+
+}
@@ -0,0 +1,253 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/executor.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sib {
+
+/*
+ * Queue statistics for one priority level of a thread_pool.
+ */
+struct queue_metrics
+{
+    std::size_t depth = 0;
+    std::uint64_t enqueued = 0;
+    std::uint64_t dequeued = 0;
+    std::chrono::nanoseconds total_wait{0};
+    std::chrono::nanoseconds max_wait{0};
+
+    std::chrono::nanoseconds mean_wait() const noexcept
+    {
+        return dequeued == 0 ? std::chrono::nanoseconds{0} : total_wait / static_cast<std::int64_t>(dequeued);
+    }
+};
+
+/*
+ * thread_pool is a fixed set of worker threads, serving one FIFO queue of jobs per priority.
+ * Workers take the most urgent job first, except that a job that has waited longer than its level's aging limit
+ * goes ahead of everything, so low priorities cannot starve.
+ * The destructor runs every job already submitted before joining the workers.
+ *
+ * Each worker's current executor is the pool itself (or the given parent), so parallel operations started by a job
+ * also run on the pool.
+ */
+class thread_pool : public executor {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // How long a job may wait at each level before it is run ahead of more urgent ones.
+    using aging_limits = std::array<clock::duration, priority_levels>;
+
+    static aging_limits default_aging() noexcept
+    {
+        using namespace std::chrono_literals;
+        return {clock::duration::max(), 10ms, 50ms};
+    }
+
+private:
+    struct Job
+    {
+        std::function<void()> function;
+        priority level;
+        clock::time_point queued;
+    };
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable idle;
+    std::array<std::deque<Job>, priority_levels> jobs;
+    std::array<queue_metrics, priority_levels> stats;
+    aging_limits aging;
+    std::size_t running;
+    bool stopping;
+    std::vector<std::thread> workers;
+
+    bool empty() const noexcept
+    {
+        return std::all_of(jobs.begin(), jobs.end(), [](auto const& queue) { return queue.empty(); });
+    }
+
+    // Chooses the queue to take from: the oldest aged-out job if there is one, else the most urgent.
+    std::size_t choose(clock::time_point now) const noexcept
+    {
+        std::size_t result = priority_levels;
+        auto oldest = clock::time_point::max();
+        for (std::size_t level = 0; level < priority_levels; ++level) {
+            if (!jobs[level].empty()) {
+                auto const queued = jobs[level].front().queued;
+                if (now - queued > aging[level] && queued < oldest) {
+                    result = level;
+                    oldest = queued;
+                }
+            }
+        }
+        if (result != priority_levels) {
+            return result;
+        }
+        for (std::size_t level = 0; level < priority_levels; ++level) {
+            if (!jobs[level].empty()) {
+                return level;
+            }
+        }
+        return priority_levels;
+    }
+
+    Job take()
+    {
+        auto const now = clock::now();
+        auto const level = choose(now);
+        auto job = std::move(jobs[level].front());
+        jobs[level].pop_front();
+
+        auto& stat = stats[level];
+        auto const waited = std::chrono::duration_cast<std::chrono::nanoseconds>(now - job.queued);
+        --stat.depth;
+        ++stat.dequeued;
+        stat.total_wait += waited;
+        stat.max_wait = std::max(stat.max_wait, waited);
+        return job;
+    }
+
+    void work(std::function<void()> const& on_start, executor* parent)
+    {
+        executor::scope const scope{parent ? parent : this};
+        if (on_start) {
+            on_start();
+        }
+        for (bool finished = false;; finished = true) {
+            Job job;
+            {
+                // A job just finished is only counted out here, so that it costs no extra lock.
+                std::unique_lock<std::mutex> lock{mutex};
+                if (finished && --running == 0 && empty()) {
+                    idle.notify_all();
+                }
+                ready.wait(lock, [this] { return stopping || !empty(); });
+                if (empty()) {
+                    return;
+                }
+                job = take();
+                ++running;
+            }
+            // Jobs spawned by this one inherit its priority.
+            priority_scope const level{job.level};
+            job.function();
+        }
+    }
+
+public:
+    explicit thread_pool(std::size_t threads = std::max(1u, std::thread::hardware_concurrency())) :
+        thread_pool{threads, {}, nullptr}
+    {}
+
+    /*
+     * Each worker calls on_start before it takes any jobs, and has parent as its current executor.
+     */
+    thread_pool(std::size_t threads, std::function<void()> on_start, executor* parent) :
+        jobs{},
+        stats{},
+        aging{default_aging()},
+        running{0},
+        stopping{false}
+    {
+        workers.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this, on_start, parent] { work(on_start, parent); });
+        }
+    }
+
+    thread_pool(thread_pool const&) = delete;
+    thread_pool& operator=(thread_pool const&) = delete;
+
+    ~thread_pool() noexcept override
+    {
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            stopping = true;
+        }
+        ready.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    std::size_t size() const noexcept
+    {
+        return workers.size();
+    }
+
+    using executor::submit;
+
+    /*
+     * Queue a job to be run on one of the workers, at the placement's priority.  The node is ignored.
+     * Jobs must not throw.
+     */
+    void submit(std::function<void()> job, placement where) override
+    {
+        auto const level = where.level == priority::inherit ? current_priority() : where.level;
+        auto const index = static_cast<std::size_t>(level);
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            jobs[index].push_back({std::move(job), level, clock::now()});
+            ++stats[index].depth;
+            ++stats[index].enqueued;
+        }
+        ready.notify_one();
+    }
+
+    /*
+     * Waits until no job is queued or running, and returns the number of jobs submitted so far.
+     * Must not be called from one of the pool's own jobs.
+     */
+    std::uint64_t drain()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        idle.wait(lock, [this] { return running == 0 && empty(); });
+        std::uint64_t submitted = 0;
+        for (auto const& stat : stats) {
+            submitted += stat.enqueued;
+        }
+        return submitted;
+    }
+
+    queue_metrics metrics(priority level)
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        return stats[static_cast<std::size_t>(level == priority::inherit ? priority::normal : level)];
+    }
+
+    /*
+     * Sets how long a job may wait at each priority before it runs ahead of more urgent ones.
+     */
+    void set_aging(aging_limits limits)
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        aging = limits;
+    }
+};
+
+/*
+ * A pool shared by the library's parallel operations, when they are not given one explicitly.
+ * It is created on first use, with one worker per hardware thread.
+ */
+inline thread_pool& default_thread_pool()
+{
+    static thread_pool pool;
+    return pool;
+}
+
+}
@@ -0,0 +1,136 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace sib {
+
+/*
+ * timer_queue makes futures that become ready at given times, or calls callbacks at given times, all kept by one
+ * thread.  So many pending delays cost one thread, and a wait for one (e.g. through a wait_policy) may suspend a fiber
+ * rather than sleeping its thread.
+ */
+class timer_queue
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::multimap<clock::time_point, std::function<void()>> timers;
+    bool stopping;
+    std::thread thread;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        for (;;) {
+            if (stopping) {
+                return;
+            }
+            if (timers.empty()) {
+                changed.wait(lock);
+                continue;
+            }
+            auto const next = timers.begin()->first;
+            if (clock::now() < next) {
+                changed.wait_until(lock, next);
+                continue;
+            }
+            auto callback = std::move(timers.begin()->second);
+            timers.erase(timers.begin());
+            lock.unlock();
+            callback();
+            lock.lock();
+        }
+    }
+
+public:
+    timer_queue() :
+        stopping{false}
+    {
+        thread = std::thread{[this] { run(); }};
+    }
+
+    timer_queue(timer_queue const&) = delete;
+    timer_queue& operator=(timer_queue const&) = delete;
+
+    /*
+     * Timers still pending are dropped, so their futures report broken_promise, and their callbacks are not called.
+     */
+    ~timer_queue() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            stopping = true;
+        }
+        changed.notify_one();
+        thread.join();
+    }
+
+    /*
+     * Calls callback on the queue's thread at deadline.  It holds up every later timer, so should be short
+     * (e.g. submit the real work to an executor), and must not throw.
+     */
+    void at(clock::time_point deadline, std::function<void()> callback)
+    {
+        {
+            std::lock_guard<std::mutex> const lock{mutex};
+            auto const entry = timers.emplace(deadline, std::move(callback));
+            if (entry != timers.begin()) {
+                return;
+            }
+        }
+        // Only a new earliest deadline changes how long the thread should sleep.
+        changed.notify_one();
+    }
+
+    void after(clock::duration delay, std::function<void()> callback)
+    {
+        at(clock::now() + delay, std::move(callback));
+    }
+
+    std::future<void> at(clock::time_point deadline)
+    {
+        // std::function must be copyable, so hold the promise by shared_ptr.
+        auto promise = std::make_shared<std::promise<void>>();
+        auto result = promise->get_future();
+        at(deadline, [promise] { promise->set_value(); });
+        return result;
+    }
+
+    std::future<void> after(clock::duration delay)
+    {
+        return at(clock::now() + delay);
+    }
+
+    std::size_t pending()
+    {
+        std::lock_guard<std::mutex> const lock{mutex};
+        return timers.size();
+    }
+
+    /*
+     * The queue shared by default.
+     */
+    static timer_queue& global()
+    {
+        static timer_queue queue;
+        return queue;
+    }
+};
+
+}
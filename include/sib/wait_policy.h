@@ -0,0 +1,245 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/race.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+
+namespace sib {
+
+/*
+ * A suspender lets waits on this thread suspend the current user-space context (e.g. a fiber) instead of blocking
+ * the thread.  fiber_executor installs one while each fiber runs.
+ */
+class suspender
+{
+private:
+    static suspender*& slot() noexcept
+    {
+        static thread_local suspender* current = nullptr;
+        return current;
+    }
+
+protected:
+    // Suspends the caller until ready(context) returns true.
+    virtual void suspend(bool (*ready)(void const*), void const* context) = 0;
+
+public:
+    virtual ~suspender() = default;
+
+    template<typename Ready>
+    void suspend_until(Ready const& ready)
+    {
+        suspend([](void const* context) { return static_cast<bool>((*static_cast<Ready const*>(context))()); }, &ready);
+    }
+
+    /*
+     * The suspender for the code now running on this thread, or nullptr if waits must block.
+     */
+    static suspender* current() noexcept
+    {
+        return slot();
+    }
+
+    class scope
+    {
+    private:
+        suspender* previous;
+
+    public:
+        explicit scope(suspender* s) noexcept :
+            previous{slot()}
+        {
+            slot() = s;
+        }
+
+        scope(scope const&) = delete;
+        scope& operator=(scope const&) = delete;
+
+        ~scope() noexcept
+        {
+            slot() = previous;
+        }
+    };
+};
+
+class wait_policy;
+
+namespace detail {
+
+inline wait_policy const*& wait_policy_slot() noexcept
+{
+    static thread_local wait_policy const* current = nullptr;
+    return current;
+}
+
+}
+
+/*
+ * wait_policy decides how a thread waits for a result that is not ready yet:
+ *  - park() blocks straight away (the standard library's behaviour);
+ *  - spin(n) polls up to n times before blocking;
+ *  - adaptive(max) polls for a number of iterations tuned from recent waits, up to max, before blocking.
+ *
+ * Copies of an adaptive policy share what they have learned.
+ */
+class wait_policy
+{
+private:
+    using clock = std::chrono::steady_clock;
+
+    // Adaptive spin counts never fall below this, so that they can grow again.
+    static constexpr std::size_t adaptive_floor = 16;
+
+    std::size_t iterations;
+    std::shared_ptr<std::atomic<std::size_t>> learned;
+
+    wait_policy(std::size_t iterations, std::shared_ptr<std::atomic<std::size_t>> learned) noexcept :
+        iterations{iterations},
+        learned{std::move(learned)}
+    {}
+
+    // Moves the learned spin count an eighth of the way to target.
+    void learn(std::size_t target) const noexcept
+    {
+        auto const old = learned->load(std::memory_order_relaxed);
+        auto const bounded = std::clamp(target, adaptive_floor, iterations);
+        learned->store(old - old / 8 + bounded / 8, std::memory_order_relaxed);
+    }
+
+public:
+    wait_policy() noexcept :
+        wait_policy{0, nullptr}
+    {}
+
+    static wait_policy park() noexcept
+    {
+        return {};
+    }
+
+    static wait_policy spin(std::size_t iterations) noexcept
+    {
+        return {iterations, nullptr};
+    }
+
+    static wait_policy adaptive(std::size_t max_iterations = 1u << 14)
+    {
+        auto const start = std::max(adaptive_floor, max_iterations / 16);
+        return {std::max(adaptive_floor, max_iterations), std::make_shared<std::atomic<std::size_t>>(start)};
+    }
+
+    /*
+     * The number of times the next wait will poll before blocking.
+     */
+    std::size_t spin_iterations() const noexcept
+    {
+        return learned ? learned->load(std::memory_order_relaxed) : iterations;
+    }
+
+    /*
+     * Polls ready() until it returns true or the spin budget is exhausted, and returns its last result.
+     * If this returns false, the caller should block and then report how long for with parked().
+     */
+    template<typename Ready>
+    bool spin_until(Ready&& ready, clock::duration* spun = nullptr) const
+    {
+        auto const budget = spin_iterations();
+        auto const start = learned ? clock::now() : clock::time_point{};
+        for (std::size_t i = 0; i < budget; ++i) {
+            if (ready()) {
+                if (learned) {
+                    // Spin for twice as long as this wait needed.
+                    learn(2 * i);
+                }
+                return true;
+            }
+            cpu_relax();
+        }
+        if (spun && learned) {
+            *spun = clock::now() - start;
+        }
+        return ready();
+    }
+
+    /*
+     * Tells an adaptive policy that, having spun for spun, a wait then blocked for blocked.
+     * If a little more spinning would have avoided blocking, spin for longer next time; otherwise for less.
+     */
+    void parked(clock::duration spun, clock::duration blocked) const noexcept
+    {
+        if (learned) {
+            auto const budget = learned->load(std::memory_order_relaxed);
+            learn(blocked < spun ? 2 * budget : budget / 2);
+        }
+    }
+
+    /*
+     * Waits for future to become ready, according to the policy.
+     * Where there is a current suspender, it suspends rather than blocks once it has finished spinning.
+     */
+    template<typename Future>
+    void wait(Future const& future) const
+    {
+        auto const ready = [&future] {
+            return future.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+        };
+        clock::duration spun{};
+        if (spin_until(ready, &spun)) {
+            return;
+        }
+        if (auto* const s = suspender::current()) {
+            s->suspend_until(ready);
+            return;
+        }
+        auto const start = learned ? clock::now() : clock::time_point{};
+        future.wait();
+        if (learned) {
+            parked(spun, clock::now() - start);
+        }
+    }
+
+    /*
+     * The innermost policy in scope on this thread, or nullptr.
+     */
+    static wait_policy const* current() noexcept
+    {
+        return detail::wait_policy_slot();
+    }
+
+    class scope;
+};
+
+/*
+ * Makes a policy current on this thread for the lifetime of the scope.
+ */
+class wait_policy::scope
+{
+private:
+    wait_policy policy;
+    wait_policy const* previous;
+
+public:
+    explicit scope(wait_policy policy) noexcept :
+        policy{std::move(policy)},
+        previous{detail::wait_policy_slot()}
+    {
+        detail::wait_policy_slot() = &this->policy;
+    }
+
+    scope(scope const&) = delete;
+    scope& operator=(scope const&) = delete;
+
+    ~scope() noexcept
+    {
+        detail::wait_policy_slot() = previous;
+    }
+};
+
+}
@@ -0,0 +1,108 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/monad/task.h"
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+
+std::vector<std::string> lookup(std::vector<int> const& keys)
+{
+    std::vector<std::string> results;
+    for (auto key : keys) {
+        results.push_back(std::to_string(key));
+    }
+    return results;
+}
+
+}
+
+TEST_CASE("Test batch_task")
+{
+    using namespace sib::monad;
+    using namespace std::chrono_literals;
+
+    SECTION("concurrent loads share one bulk call")
+    {
+        std::vector<std::size_t> sizes;
+        sib::batch_task<std::string(int)> const loader{[&sizes](std::vector<int> const& keys) {
+            sizes.push_back(keys.size());
+            return lookup(keys);
+        }, 50ms};
+
+        std::vector<sib::shared_task<std::string()>> results;
+        for (int i = 0; i < 10; ++i) {
+            results.push_back(loader.load(i));
+        }
+        for (int i = 0; i < 10; ++i) {
+            CHECK((results[static_cast<std::size_t>(i)] | get()) == std::to_string(i));
+        }
+        CHECK(loader.batches() == 1);
+        CHECK(loader.keys() == 10);
+        CHECK(sizes == std::vector<std::size_t>{10});
+    }
+
+    SECTION("batches are limited in size")
+    {
+        sib::batch_task<std::string(int)> const loader{lookup, std::chrono::seconds{10}, 4};
+        std::vector<sib::shared_task<std::string()>> results;
+        for (int i = 0; i < 8; ++i) {
+            results.push_back(loader.load(i));
+        }
+        // Two full batches go at once, without waiting for the window.
+        CHECK((results[7] | get()) == "7"s);
+        CHECK(loader.batches() == 2);
+    }
+
+    SECTION("calls from many threads coalesce")
+    {
+        sib::batch_task<std::string(int)> const loader{lookup, 20ms};
+        std::vector<std::thread> threads;
+        std::atomic<int> correct{0};
+        for (int i = 0; i < 8; ++i) {
+            threads.emplace_back([&loader, &correct, i] {
+                if ((loader | get(i)) == std::to_string(i)) {
+                    ++correct;
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(correct == 8);
+        CHECK(loader.batches() < 8);
+    }
+
+    SECTION("failures reach every caller in the batch")
+    {
+        sib::batch_task<int(int)> const throwing{[](std::vector<int> const&) -> std::vector<int> {
+            throw std::runtime_error{"Exception!"};
+        }, 10ms};
+        auto const a = throwing.load(1);
+        auto const b = throwing.load(2);
+        CHECK_THROWS_AS(a | get(), std::runtime_error);
+        CHECK_THROWS_AS(b | get(), std::runtime_error);
+
+        sib::batch_task<int(int)> const short_changed{[](std::vector<int> const&) { return std::vector<int>{}; }};
+        CHECK_THROWS_AS(short_changed | get(1), std::length_error);
+    }
+
+    SECTION("composes like a task")
+    {
+        sib::batch_task<std::string(int)> const loader{lookup, 10ms};
+        CHECK((loader.load(42) | then([](auto const& s) { return s + "!"s; }) | get()) == "42!"s);
+        CHECK((loader | then([](auto const& s) { return s.size(); }) | get(12345)) == 5);
+        CHECK((when_all(loader.load(1), loader.load(2)) | get()) == std::make_tuple("1"s, "2"s));
+        auto both = (in::parallel & loader & loader).value;
+        auto result = both.get_future();
+        both(3, 4);
+        CHECK(result.get() == std::make_tuple("3"s, "4"s));
+        CHECK(((in::sequence ^ loader ^ loader) | get(5)) == "5"s);
+    }
+}
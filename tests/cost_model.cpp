@@ -0,0 +1,159 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/monad/task.h"
+#include "sib/monad/function.h"
+#include <string>
+
+using namespace std::string_literals;
+
+TEST_CASE("Test cost_model")
+{
+    using namespace std::chrono_literals;
+    std::type_index const key = typeid(int);
+
+    SECTION("estimates are moving averages")
+    {
+        sib::cost_model model{{1ms, 2}};
+        CHECK(model.estimate(key) == std::nullopt);
+        model.record(key, 100ns);
+        CHECK(model.estimate(key) == 100ns);
+        model.record(key, 300ns);
+        CHECK(model.estimate(key) == 200ns);
+        CHECK(model.decisions().samples == 2);
+        model.reset();
+        CHECK(model.estimate(key) == std::nullopt);
+        CHECK(model.decisions().samples == 0);
+    }
+
+    SECTION("decisions follow the thresholds")
+    {
+        sib::cost_model model{{10us}};
+        CHECK_FALSE(model.parallel(key));   // no history yet
+        model.record(key, 1us);
+        CHECK_FALSE(model.parallel(key));
+        model.limits({500ns});
+        CHECK(model.parallel(key));
+
+        auto const counts = model.decisions();
+        CHECK(counts.sequential == 2);
+        CHECK(counts.parallel == 1);
+    }
+
+    SECTION("cost_model::scope")
+    {
+        sib::cost_model model;
+        CHECK(&sib::cost_model::current() == &sib::cost_model::global());
+        {
+            sib::cost_model::scope const scope{model};
+            CHECK(&sib::cost_model::current() == &model);
+        }
+        CHECK(&sib::cost_model::current() == &sib::cost_model::global());
+    }
+}
+
+TEST_CASE("Test in::automatic")
+{
+    using namespace sib::monad;
+    using namespace std::chrono_literals;
+
+    auto const hello = [] { return "Hello"s; };
+    auto const slow = [] {
+        std::this_thread::sleep_for(1ms);
+        return "World!"s;
+    };
+
+    SECTION("cheap operands stay in sequence")
+    {
+        sib::cost_model model{{10ms}};
+        sib::cost_model::scope const scope{model};
+
+        for (int i = 0; i < 10; ++i) {
+            std::packaged_task<std::string()> lhs{hello};
+            std::packaged_task<std::string()> rhs{hello};
+            CHECK((when_all(in::automatic, std::move(lhs), std::move(rhs)) | get()) == std::make_tuple("Hello"s, "Hello"s));
+        }
+        auto const counts = model.decisions();
+        CHECK(counts.sequential == 10);
+        CHECK(counts.parallel == 0);
+        CHECK(counts.samples == 10);
+    }
+
+    SECTION("expensive operands go parallel once measured")
+    {
+        sib::cost_model model;
+        sib::cost_model::scope const scope{model};
+
+        for (int i = 0; i < 3; ++i) {
+            std::packaged_task<std::string()> lhs{slow};
+            std::packaged_task<std::string()> rhs{slow};
+            CHECK((when_all(in::automatic, std::move(lhs), std::move(rhs)) | get()) == std::make_tuple("World!"s, "World!"s));
+
+            std::packaged_task<std::string()> fast{hello};
+            std::packaged_task<std::string()> other{slow};
+            auto const any = (in::automatic ^ std::move(other) ^ std::move(fast)) | get();
+            CHECK((any == "Hello"s || any == "World!"s));
+        }
+        auto const counts = model.decisions();
+        CHECK(counts.sequential == 2);
+        CHECK(counts.parallel == 4);
+        CHECK(counts.samples == 6);
+    }
+
+    SECTION("parallel when_any is costed as it would be in sequence")
+    {
+        // Each sample replaces the estimate, so a single underestimate would send the next call back to sequence.
+        sib::cost_model model{{500us, 1}};
+        sib::cost_model::scope const scope{model};
+
+        for (int i = 0; i < 5; ++i) {
+            std::packaged_task<std::string()> lhs{[] {
+                std::this_thread::sleep_for(2ms);
+                return "World!"s;
+            }};
+            std::packaged_task<std::string()> rhs{hello};
+            auto const any = (in::automatic ^ std::move(lhs) ^ std::move(rhs)) | get();
+            CHECK((any == "Hello"s || any == "World!"s));
+        }
+        // In sequence, the slow lhs always runs, so the fast rhs winning in parallel does not make it cheap.
+        auto const counts = model.decisions();
+        CHECK(counts.sequential == 1);
+        CHECK(counts.parallel == 4);
+        CHECK(model.estimate(typeid(sib::monad::detail::CostKey<sib::monad::detail::AnyOf, std::string(), 2>)) >= 2ms);
+    }
+
+    SECTION("each level of a ^ chain is costed under its own key")
+    {
+        sib::cost_model model;
+        sib::cost_model::scope const scope{model};
+
+        std::packaged_task<std::string()> a{slow};
+        std::packaged_task<std::string()> b{hello};
+        std::packaged_task<std::string()> c{hello};
+        CHECK(((in::automatic ^ std::move(a) ^ std::move(b) ^ std::move(c)) | get()) == "World!"s);
+
+        // The inner a ^ b and the outer (a ^ b) ^ c are measured apart, rather than blended into one average.
+        using detail::AnyOf;
+        using detail::CostKey;
+        CHECK(model.decisions().samples == 2);
+        CHECK(model.estimate(typeid(CostKey<AnyOf, std::string(), 2, 0>)) != std::nullopt);
+        CHECK(model.estimate(typeid(CostKey<AnyOf, std::string(), 2, 1>)) != std::nullopt);
+    }
+
+    SECTION("thresholds can be overridden")
+    {
+        sib::cost_model model{{std::chrono::hours{1}}};
+        sib::cost_model::scope const scope{model};
+
+        for (int i = 0; i < 3; ++i) {
+            std::function<std::string()> lhs{slow};
+            std::function<std::string()> rhs{slow};
+            CHECK(((in::automatic ^ lhs ^ rhs) | get()) == "World!"s);
+        }
+        CHECK(model.decisions().parallel == 0);
+        CHECK(model.decisions().sequential == 3);
+    }
+}
@@ -0,0 +1,137 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "instrumentation/instrumentation.h"
+#include "sib/monad/function.h"
+#include "sib/monad/optional.h"
+#include "sib/monad/task.h"
+#include <string>
+
+// Pins the heap allocations and threads that each combinator costs, so that a change that adds to them fails here.
+// Allocations are counted on the calling thread only.  Bounds, rather than exact counts, allow for differences in
+// standard libraries.
+TEST_CASE("Test combinator costs")
+{
+    using namespace sib::monad;
+    using sib::test::allocation_counter;
+    using sib::test::spawn_counter;
+
+    auto const twice = [](int x) { return x + x; };
+    auto const one = [] { return std::packaged_task<int()>{[] { return 1; }}; };
+
+    SECTION("the instruments count")
+    {
+        allocation_counter const counter;
+        // Called directly, because the compiler may elide a new-expression.
+        ::operator delete(::operator new(sizeof(int)));
+        auto const counts = counter.counts();
+        CHECK(counts.allocations == 1);
+        CHECK(counts.deallocations == 1);
+        CHECK(counts.bytes == sizeof(int));
+
+        spawn_counter const spawns;
+        std::promise<void> done;
+        sib::spawn([&done] { done.set_value(); });
+        done.get_future().wait();
+        CHECK(spawns.spawns() == 1);
+        CHECK(spawns.threads() == 1);
+    }
+
+    SECTION("optional")
+    {
+        std::optional<int> const opt = 42;
+        allocation_counter const counter;
+        CHECK((opt | then(twice) | get()) == 84);
+        CHECK((opt | then([](int x) { return std::optional<int>{x}; }) | flatten() | get()) == 42);
+        CHECK((when_all(opt, opt, opt) | get()) == std::make_tuple(42, 42, 42));
+        CHECK((when_any(std::optional<int>{}, opt) | get()) == 42);
+        CHECK(counter.allocations() == 0);
+    }
+
+    SECTION("function")
+    {
+        std::function<int(int)> const f = twice;
+        {
+            allocation_counter const counter;
+            CHECK((f | get(21)) == 42);
+            CHECK(counter.allocations() == 0);
+        }
+        {
+            allocation_counter const counter;
+            auto const g = f | then(twice);
+            // The composed std::function holds both callables, so does not fit in the small buffer.
+            CHECK(counter.allocations() <= 1);
+            CHECK((g | get(1)) == 4);
+        }
+        {
+            std::vector<std::tuple<int>> arguments(10000, std::tuple<int>{1});
+            sib::thread_pool pool{3};
+            allocation_counter const counter;
+            auto const results = f | get_batch(pool, arguments);
+            // The results are written straight into the vector: no storage for them beyond its own.
+            CHECK(counter.counts().bytes < sizeof(int) * arguments.size() + 1024);
+            CHECK(results == std::vector<int>(arguments.size(), 2));
+        }
+    }
+
+    SECTION("shared_task")
+    {
+        sib::shared_task<int()> const task{[] { return 42; }};
+        task();
+        allocation_counter const counter;
+        CHECK((task | get()) == 42);
+        CHECK(counter.allocations() == 0);
+    }
+
+    SECTION("packaged_task")
+    {
+        {
+            allocation_counter const counter;
+            CHECK((one() | get()) == 1);
+            // The shared state, and the callable.
+            CHECK(counter.allocations() <= 2);
+        }
+        {
+            allocation_counter const counter;
+            CHECK((one() | then(twice) | get()) == 2);
+            CHECK(counter.allocations() <= 4);
+        }
+        {
+            allocation_counter const counter;
+            spawn_counter const spawns;
+            CHECK((when_all(in::sequence, one(), one(), one(), one()) | get()) == std::make_tuple(1, 1, 1, 1));
+            CHECK(spawns.spawns() == 0);
+            CHECK(counter.allocations() <= 24);
+        }
+    }
+
+    SECTION("parallel when_all and when_any")
+    {
+        {
+            spawn_counter const spawns;
+            CHECK((when_all(in::parallel, one(), one(), one(), one()) | get()) == std::make_tuple(1, 1, 1, 1));
+            // when_all spawns every operand but the first, which it runs on the calling thread.
+            CHECK(spawns.spawns() == 3);
+            CHECK(spawns.threads() <= 3);
+        }
+        {
+            spawn_counter const spawns;
+            CHECK((when_any(in::parallel, one(), one(), one(), one()) | get()) == 1);
+            // when_any spawns each operand once, and waits for them all on one race.
+            CHECK(spawns.spawns() <= 4);
+            CHECK(spawns.threads() <= 4);
+        }
+        {
+            sib::thread_pool pool{2};
+            sib::executor::scope const scope{&pool};
+            spawn_counter const spawns;
+            CHECK((when_all(in::parallel, one(), one(), one(), one()) | get()) == std::make_tuple(1, 1, 1, 1));
+            CHECK(spawns.spawns() == 3);
+            // On an executor, spawned work starts no threads.
+            CHECK(spawns.threads() == 0);
+        }
+    }
+}
@@ -0,0 +1,322 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/monad/scope.h"
+#include "sib/monad/task.h"
+#include "sib/numa_executor.h"
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+TEST_CASE("Test executors")
+{
+    using namespace sib::monad;
+
+    SECTION("executor::scope")
+    {
+        sib::thread_pool pool{1};
+        CHECK(sib::executor::current() == nullptr);
+        {
+            sib::executor::scope const scope{&pool};
+            CHECK(sib::executor::current() == &pool);
+        }
+        CHECK(sib::executor::current() == nullptr);
+    }
+
+    SECTION("spawn runs on the current executor")
+    {
+        sib::thread_pool pool{2};
+        sib::executor::scope const scope{&pool};
+
+        std::promise<sib::executor*> promise;
+        sib::spawn([&promise] { promise.set_value(sib::executor::current()); });
+        CHECK(promise.get_future().get() == &pool);
+    }
+
+    SECTION("spawned jobs run exactly once")
+    {
+        sib::thread_pool pool{1};
+        sib::executor::scope const scope{&pool};
+
+        // Keep the only worker busy, so that the caller gets to claim the job.
+        std::promise<void> release;
+        pool.submit([future = release.get_future().share()] { future.wait(); });
+
+        int runs = 0;
+        auto const job = sib::spawn([&runs] { ++runs; });
+        CHECK(job.try_run());
+        CHECK_FALSE(job.try_run());
+        release.set_value();
+        CHECK(runs == 1);
+    }
+
+    SECTION("parallel combinators on a saturated pool do not deadlock")
+    {
+        sib::thread_pool pool{1};
+        sib::executor::scope const scope{&pool};
+
+        auto const make = [](std::string s) {
+            return std::packaged_task<std::string()>{[s] { return s; }};
+        };
+        auto const merge = [](auto const& x, auto const& y, auto const& z) { return x + y + z; };
+
+        // Run the whole combination on the pool's only worker.
+        std::packaged_task<std::string()> all{[&] {
+            return (in::parallel & make("a") & make("b") & make("c")) | apply(merge) | get();
+        }};
+        auto result = all.get_future();
+        pool.submit([&all] { all(); });
+        CHECK(result.get() == "abc"s);
+
+        std::packaged_task<std::string()> any{[&] {
+            return (in::parallel ^ make("a") ^ make("a")) | get();
+        }};
+        result = any.get_future();
+        pool.submit([&any] { any(); });
+        CHECK(result.get() == "a"s);
+    }
+}
+
+TEST_CASE("Test priorities")
+{
+    using namespace sib::monad;
+    using sib::priority;
+
+    // Occupies a pool's only worker until released.
+    struct Blocker
+    {
+        std::promise<void> release;
+
+        explicit Blocker(sib::thread_pool& pool)
+        {
+            std::promise<void> started;
+            pool.submit([&started, released = release.get_future().share()] {
+                started.set_value();
+                released.wait();
+            });
+            started.get_future().wait();
+        }
+    };
+
+    SECTION("urgent jobs run first")
+    {
+        std::vector<priority> order;
+        std::mutex mutex;
+        auto const record = [&](priority level) {
+            return [&order, &mutex, level] {
+                std::lock_guard<std::mutex> const lock{mutex};
+                order.push_back(level);
+            };
+        };
+        {
+            sib::thread_pool pool{1};
+            Blocker blocker{pool};
+            pool.submit(record(priority::low), {-1, priority::low});
+            pool.submit(record(priority::normal), {-1, priority::normal});
+            pool.submit(record(priority::high), {-1, priority::high});
+            blocker.release.set_value();
+        }
+        CHECK(order == std::vector<priority>{priority::high, priority::normal, priority::low});
+    }
+
+    SECTION("old jobs are not starved")
+    {
+        std::vector<priority> order;
+        std::mutex mutex;
+        auto const record = [&](priority level) {
+            return [&order, &mutex, level] {
+                std::lock_guard<std::mutex> const lock{mutex};
+                order.push_back(level);
+            };
+        };
+        {
+            sib::thread_pool pool{1};
+            auto aging = sib::thread_pool::default_aging();
+            aging[static_cast<std::size_t>(priority::low)] = std::chrono::milliseconds{1};
+            pool.set_aging(aging);
+
+            Blocker blocker{pool};
+            pool.submit(record(priority::low), {-1, priority::low});
+            std::this_thread::sleep_for(std::chrono::milliseconds{5});
+            pool.submit(record(priority::high), {-1, priority::high});
+            blocker.release.set_value();
+        }
+        CHECK(order == std::vector<priority>{priority::low, priority::high});
+    }
+
+    SECTION("jobs inherit the submitting thread's priority")
+    {
+        sib::thread_pool pool{1};
+        std::promise<priority> inner;
+        {
+            sib::priority_scope const level{priority::low};
+            pool.submit([&pool, &inner] {
+                pool.submit([&inner] { inner.set_value(sib::current_priority()); });
+            });
+        }
+        CHECK(inner.get_future().get() == priority::low);
+        CHECK(sib::current_priority() == priority::normal);
+        CHECK(pool.metrics(priority::low).enqueued == 2);
+    }
+
+    SECTION("queue metrics")
+    {
+        sib::thread_pool pool{1};
+        {
+            Blocker blocker{pool};
+            pool.submit([] {}, {-1, priority::high});
+            pool.submit([] {}, {-1, priority::high});
+            auto const queued = pool.metrics(priority::high);
+            CHECK(queued.depth == 2);
+            CHECK(queued.enqueued == 2);
+            CHECK(queued.dequeued == 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds{2});
+            blocker.release.set_value();
+        }
+        std::promise<void> drained;
+        pool.submit([&drained] { drained.set_value(); }, {-1, priority::high});
+        drained.get_future().wait();
+
+        auto const done = pool.metrics(priority::high);
+        CHECK(done.depth == 0);
+        CHECK(done.dequeued == 3);
+        CHECK(done.max_wait >= std::chrono::milliseconds{2});
+        CHECK(done.mean_wait() <= done.max_wait);
+        CHECK(pool.metrics(priority::low).enqueued == 0);
+    }
+
+    SECTION("task | at(...)")
+    {
+        sib::thread_pool pool{2};
+        sib::executor::scope const executor{&pool};
+
+        std::packaged_task<priority()> lhs{[] { return sib::current_priority(); }};
+        std::packaged_task<priority()> rhs{[] { return sib::current_priority(); }};
+        auto const both = when_all(in::parallel, std::move(lhs), std::move(rhs)) | at(priority::high) | get();
+        CHECK(both == std::make_tuple(priority::high, priority::high));
+        CHECK(pool.metrics(priority::high).enqueued == 1);
+    }
+}
+
+TEST_CASE("Test NUMA placement")
+{
+    using namespace sib::monad;
+
+    SECTION("parse_cpulist")
+    {
+        CHECK(sib::affinity::parse_cpulist("0-3,8,10-11\n") == std::vector{0, 1, 2, 3, 8, 10, 11});
+        CHECK(sib::affinity::parse_cpulist("").empty());
+    }
+
+    SECTION("numa_nodes covers at least one CPU")
+    {
+        auto const& nodes = sib::affinity::numa_nodes();
+        REQUIRE_FALSE(nodes.empty());
+        CHECK_FALSE(nodes.front().empty());
+    }
+
+    SECTION("numa_executor runs placed jobs in the node's group")
+    {
+        sib::numa_executor numa;
+        REQUIRE(numa.size() == sib::affinity::numa_nodes().size());
+
+        std::promise<std::vector<int>> cpus;
+        numa.submit([&cpus] { cpus.set_value(sib::affinity::this_thread_cpus()); }, sib::placement{0});
+        auto const ran_on = cpus.get_future().get();
+
+        std::set<int> const node0{sib::affinity::numa_nodes()[0].begin(), sib::affinity::numa_nodes()[0].end()};
+        for (auto cpu : ran_on) {
+            CHECK(node0.count(cpu) == 1);
+        }
+    }
+
+    SECTION("numa_executor without CPU groups has one unpinned group")
+    {
+        sib::numa_executor numa{{}};
+        CHECK(numa.size() == 1);
+
+        std::promise<sib::executor*> where;
+        numa.submit([&where] { where.set_value(sib::executor::current()); }, sib::placement{3});
+        CHECK(where.get_future().get() == &numa);
+    }
+
+    SECTION("numa_executor runs jobs submitted across groups before destroying any")
+    {
+        auto const cpu = sib::affinity::this_thread_cpus().front();
+        std::atomic<bool> ran{false};
+        {
+            sib::numa_executor numa{{{cpu}, {cpu}}};
+            numa.submit([&numa, &ran] {
+                // By now, group 0 is idle, and would already be destroyed if groups were torn down in order.
+                std::this_thread::sleep_for(std::chrono::milliseconds{50});
+                numa.submit([&ran] { ran = true; }, sib::placement{0});
+            }, sib::placement{1});
+        }
+        CHECK(ran);
+    }
+
+    SECTION("parallel combinators use the numa_executor")
+    {
+        sib::numa_executor numa{sib::numa_executor::cores()};
+        sib::executor::scope const scope{&numa};
+
+        std::packaged_task<sib::executor*()> where1{[] { return sib::executor::current(); }};
+        std::packaged_task<sib::executor*()> where2{[] { return sib::executor::current(); }};
+        auto const both = (in::parallel & std::move(where1) & std::move(where2)) | get();
+        CHECK(std::get<1>(both) == &numa);
+    }
+
+    SECTION("task | on(...) on a numa_executor")
+    {
+        sib::numa_executor numa{sib::numa_executor::cores()};
+        sib::executor::scope const scope{&numa};
+        auto const node = static_cast<int>(numa.size() - 1);
+        auto const where = [] {
+            return std::packaged_task<std::thread::id()>{[] { return std::this_thread::get_id(); }};
+        };
+
+        // The task is submitted to the node's group, rather than pinning the calling thread.
+        CHECK(((where() | on(sib::placement{node})) | get()) != std::this_thread::get_id());
+
+        // On one of the node's own workers, it runs in place.
+        std::promise<bool> in_place;
+        numa.submit([&] {
+            in_place.set_value(((where() | on(sib::placement{node})) | get()) == std::this_thread::get_id());
+        }, sib::placement{node});
+        CHECK(in_place.get_future().get());
+    }
+
+    SECTION("task | on(...) under a cancelled scope")
+    {
+        sib::numa_executor numa{sib::numa_executor::cores()};
+        sib::executor::scope const executor{&numa};
+        scope tracked;
+        tracked.cancel();
+
+        // The submitted job is dropped unrun, which breaks the task's promise rather than leaving the caller waiting.
+        std::packaged_task<int()> task{[] { return 1; }};
+        CHECK_THROWS_AS((std::move(task) | on(sib::placement{static_cast<int>(numa.size() - 1)})) | get(),
+                        std::future_error);
+    }
+
+    SECTION("task | on(...)")
+    {
+        auto const before = sib::affinity::this_thread_cpus();
+        auto const& node0 = sib::affinity::numa_nodes()[0];
+
+        std::packaged_task<std::vector<int>()> cpus{[] { return sib::affinity::this_thread_cpus(); }};
+        auto const pinned = (std::move(cpus) | on(sib::placement{0})) | get();
+        // (unless we are not allowed to change affinity, in which case the task runs where it was)
+        std::set<int> const allowed{node0.begin(), node0.end()};
+        CHECK((pinned == before || std::all_of(pinned.begin(), pinned.end(), [&](int cpu) { return allowed.count(cpu) == 1; })));
+        // The thread's affinity is restored afterwards
+        CHECK(sib::affinity::this_thread_cpus() == before);
+    }
+}
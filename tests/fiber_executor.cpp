@@ -0,0 +1,148 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/fiber_executor.h"
+#include "sib/monad/task.h"
+#include <future>
+#include <string>
+
+using namespace std::string_literals;
+
+TEST_CASE("Test fiber_executor")
+{
+    using namespace sib::monad;
+
+    SECTION("jobs run on the executor")
+    {
+        sib::fiber_executor fibers{2};
+        CHECK(fibers.size() == 2);
+
+        std::promise<sib::executor*> promise;
+        fibers.submit([&promise] { promise.set_value(sib::executor::current()); });
+        CHECK(promise.get_future().get() == &fibers);
+    }
+
+    SECTION("blocked waits do not block the thread")
+    {
+        // A gate that is being run (and held shut) by another thread, so that anybody else calling it must wait.
+        std::promise<int> open;
+        std::atomic<bool> entered{false};
+        sib::shared_task<int()> const gate{[&entered, opened = open.get_future().share()] {
+            entered = true;
+            return opened.get();
+        }};
+        std::thread keeper{[gate] { gate(); }};
+        while (!entered) {
+            std::this_thread::yield();
+        }
+
+        constexpr int waiters = 1000;
+        std::atomic<int> total{0};
+        std::atomic<int> remaining{waiters};
+        std::promise<void> done;
+        {
+            // With a single thread, every waiter after the first would deadlock if waiting blocked the thread.
+            sib::fiber_executor fibers{1};
+            for (int i = 0; i < waiters; ++i) {
+                fibers.submit([&, i] {
+                    total += gate | then([i](int x) { return x + i; }) | get();
+                    if (--remaining == 0) {
+                        done.set_value();
+                    }
+                });
+            }
+
+            // Something else can still run on the thread while all the waiters are blocked.
+            std::promise<int> other;
+            fibers.submit([&other] { other.set_value(42); });
+            CHECK(other.get_future().get() == 42);
+            CHECK(remaining == waiters);
+
+            open.set_value(1);
+            done.get_future().get();
+        }
+        keeper.join();
+        CHECK(total == waiters + waiters * (waiters - 1) / 2);
+    }
+
+    SECTION("parallel combinators within fibers")
+    {
+        sib::fiber_executor fibers{1};
+        std::promise<std::tuple<std::string, std::string>> all;
+        std::promise<std::string> any;
+        fibers.submit([&all, &any] {
+            std::packaged_task<std::string()> hello{[] { return "Hello"s; }};
+            std::packaged_task<std::string()> world{[] { return "World!"s; }};
+            all.set_value(when_all(in::parallel, std::move(hello), std::move(world)) | get());
+
+            std::packaged_task<std::string()> except{[]() -> std::string { throw std::runtime_error{"Exception!"}; }};
+            std::packaged_task<std::string()> there{[] { return "there"s; }};
+            any.set_value((in::parallel ^ std::move(except) ^ std::move(there)) | get());
+        });
+        CHECK(all.get_future().get() == std::make_tuple("Hello"s, "World!"s));
+        CHECK(any.get_future().get() == "there"s);
+    }
+
+    SECTION("each fiber keeps its own scopes")
+    {
+        struct Seen
+        {
+            sib::cost_model* costs;
+            sib::priority level;
+            sib::wait_policy const* waits;
+        };
+        auto const seen = [] {
+            return Seen{&sib::cost_model::current(), sib::current_priority(), sib::wait_policy::current()};
+        };
+
+        // On one thread, a enters its scopes and suspends, then b enters its own over them and suspends.
+        // Each then resumes, and leaves its scopes, while the other is still inside its own.
+        sib::cost_model model_a;
+        sib::cost_model model_b;
+        std::promise<void> go_a;
+        std::promise<void> go_b;
+        std::promise<void> b_waiting;
+        std::promise<Seen> seen_a;
+        std::promise<Seen> seen_b;
+        std::promise<Seen> seen_after;
+        {
+            sib::fiber_executor fibers{1};
+            fibers.submit([&, go = go_a.get_future().share()] {
+                sib::cost_model::scope const costs{model_a};
+                sib::priority_scope const level{sib::priority::high};
+                sib::current_wait_policy().wait(go);
+                seen_a.set_value(seen());
+            });
+            fibers.submit([&, go = go_b.get_future().share()] {
+                sib::cost_model::scope const costs{model_b};
+                sib::wait_policy::scope const waits{sib::wait_policy::park()};
+                b_waiting.set_value();
+                sib::current_wait_policy().wait(go);
+                seen_b.set_value(seen());
+            });
+
+            b_waiting.get_future().get();
+            go_a.set_value();
+            auto const a = seen_a.get_future().get();
+            CHECK(a.costs == &model_a);
+            CHECK(a.level == sib::priority::high);
+            CHECK(a.waits == nullptr);
+
+            go_b.set_value();
+            auto const b = seen_b.get_future().get();
+            CHECK(b.costs == &model_b);
+            CHECK(b.level == sib::priority::normal);
+            CHECK(b.waits != nullptr);
+
+            // Neither fiber's scopes outlive it on the thread.
+            fibers.submit([&] { seen_after.set_value(seen()); });
+            auto const after = seen_after.get_future().get();
+            CHECK(after.costs == &sib::cost_model::global());
+            CHECK(after.level == sib::priority::normal);
+            CHECK(after.waits == nullptr);
+        }
+    }
+}
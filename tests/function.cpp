@@ -5,8 +5,25 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "sib/monad/function.h"
+#include <algorithm>
 #include <string>
 
+namespace {
+
+// Counts its live instances.
+struct Tracked
+{
+    static inline int live = 0;
+
+    int value;
+
+    explicit Tracked(int value) : value{value} { ++live; }
+    Tracked(Tracked const& rhs) : value{rhs.value} { ++live; }
+    ~Tracked() { --live; }
+};
+
+}
+
 TEST_CASE("Test monadic operations on std::function")
 {
     using namespace sib::monad;
@@ -30,6 +47,75 @@ TEST_CASE("Test monadic operations on std::function")
         CHECK((echo | get("World")) == "World"s);
     }
 
+    SECTION("function | get_batch(...)")
+    {
+        std::function<int(int, int)> const add = [](int x, int y) { return x + y; };
+        auto const twice = add | then([](int x) { return 2 * x; });
+
+        std::vector<std::tuple<int, int>> arguments;
+        std::vector<int> expected;
+        for (int i = 0; i < 10000; ++i) {
+            arguments.emplace_back(i, 1);
+            expected.push_back(2 * (i + 1));
+        }
+
+        CHECK((twice | get_batch(arguments)) == expected);
+        CHECK((twice | get_batch(in::parallel, arguments)) == expected);
+
+        sib::thread_pool pool{3};
+        CHECK((twice | get_batch(pool, arguments)) == expected);
+
+        // Each result has a slot of its own, so even std::vector<bool>'s packed bits are written by one thread.
+        std::function<bool(int, int)> const odd = [](int x, int) { return x % 2 == 1; };
+        std::vector<bool> odds;
+        for (int i = 0; i < 10000; ++i) {
+            odds.push_back(i % 2 == 1);
+        }
+        CHECK((odd | get_batch(pool, arguments)) == odds);
+
+        // Results need not be default-constructible
+        struct Sum
+        {
+            int value;
+            explicit Sum(int v) : value{v} {}
+        };
+        std::function<Sum(int, int)> const sum = [](int x, int y) { return Sum{x + y}; };
+        auto const sums = sum | get_batch(pool, arguments);
+        CHECK(std::all_of(sums.begin(), sums.end(), [&](Sum const& s) { return s.value == (&s - sums.data()) + 1; }));
+
+        // Get can carry each set of arguments too
+        std::vector<Get<std::string>> const words{get("Hello"s), get("World"s)};
+        CHECK((echo | get_batch(in::parallel, words)) == std::vector{"Hello"s, "World"s});
+
+        std::function<int(int)> const except = [](int x) -> int {
+            if (x == 5000) {
+                throw std::runtime_error{"Exception!"};
+            }
+            return x;
+        };
+        std::vector<std::tuple<int>> singles;
+        for (int i = 0; i < 10000; ++i) {
+            singles.emplace_back(i);
+        }
+        CHECK_THROWS_AS(except | get_batch(pool, singles), std::runtime_error);
+
+        // Results that are not default-constructible are built in place, and those built are destroyed on failure
+        Tracked::live = 0;
+        std::function<Tracked(int)> const tracked = [](int x) {
+            if (x == 5000) {
+                throw std::runtime_error{"Exception!"};
+            }
+            return Tracked{x};
+        };
+        CHECK_THROWS_AS(tracked | get_batch(pool, singles), std::runtime_error);
+        CHECK(Tracked::live == 0);
+
+        singles.resize(5000);
+        auto const built = tracked | get_batch(pool, singles);
+        CHECK(Tracked::live == 5000);
+        CHECK(built[4999].value == 4999);
+    }
+
     SECTION("function | flatten()")
     {
         std::function<std::function<std::string(std::string const&)>(unsigned int)> const fun_of_fun = [](unsigned int n){
@@ -78,5 +164,13 @@ TEST_CASE("Test monadic operations on std::function")
         CHECK((when_all(hello, there, world) | apply(merge) | get()) == "Hello, there, World!"s);
 
         CHECK(((in::parallel & hello & there & world) | apply(merge) | get()) == "Hello, there, World!"s);
+
+        // when_all makes one function, which may be called repeatedly, taking all of its operands' arguments.
+        std::function<std::string(std::string const&)> const echo = [](std::string const& s) { return s; };
+        auto const all = when_all(in::parallel, echo, hello, echo);
+        static_assert(std::is_same_v<decltype(all),
+            std::function<std::tuple<std::string, std::string, std::string>(std::string const&, std::string const&)> const>);
+        CHECK((all | get("there"s, "World!"s)) == std::make_tuple("there"s, "Hello"s, "World!"s));
+        CHECK((all | apply(merge) | get("1"s, "2"s)) == "1, Hello, 2"s);
     }
 }
@@ -0,0 +1,142 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/monad/future.h"
+#include "sib/thread_pool.h"
+#include <string>
+#include <thread>
+
+using namespace std::string_literals;
+
+namespace {
+
+template<typename T>
+std::future<T> ready(T value)
+{
+    std::promise<T> promise;
+    promise.set_value(std::move(value));
+    return promise.get_future();
+}
+
+template<typename T>
+std::future<T> failed()
+{
+    std::promise<T> promise;
+    promise.set_exception(std::make_exception_ptr(std::runtime_error{"Exception!"}));
+    return promise.get_future();
+}
+
+}
+
+TEST_CASE("Test future")
+{
+    using namespace sib::monad;
+
+    SECTION("future | get()")
+    {
+        CHECK((ready("Hello"s) | get()) == "Hello"s);
+        CHECK((ready("Hello"s).share() | get()) == "Hello"s);
+        CHECK_THROWS_AS(failed<int>() | get(), std::runtime_error);
+    }
+
+    SECTION("future | then(f)")
+    {
+        std::promise<std::string> promise;
+        auto greeting = promise.get_future() | then([](auto const& s) { return s + ", World!"s; });
+        promise.set_value("Hello");
+        CHECK((std::move(greeting) | get()) == "Hello, World!"s);
+
+        auto const shared = ready("Hello"s).share();
+        CHECK((shared | then([](auto const& s) { return s.size(); }) | get()) == 5);
+        CHECK((shared | get()) == "Hello"s);
+
+        CHECK_THROWS_AS(failed<int>() | then([](int i) { return i + 1; }) | get(), std::runtime_error);
+        CHECK_THROWS_AS(ready(1) | then([](int) -> int { throw std::logic_error{"Exception!"}; }) | get(),
+                        std::logic_error);
+
+        std::promise<void> done;
+        auto after = done.get_future() | then([] { return "done"s; });
+        done.set_value();
+        CHECK((std::move(after) | get()) == "done"s);
+    }
+
+    SECTION("future | then(f) returning a future is flattened")
+    {
+        std::promise<int> inner;
+        auto chained = ready(1) | then([&inner](int) { return inner.get_future(); });
+        static_assert(std::is_same_v<decltype(chained), std::future<int>>);
+        inner.set_value(42);
+        CHECK((std::move(chained) | get()) == 42);
+    }
+
+    SECTION("continuations run on the current executor")
+    {
+        sib::thread_pool pool{1};
+        std::promise<std::thread::id> where;
+        auto worker = where.get_future();
+        pool.submit([&where] { where.set_value(std::this_thread::get_id()); });
+        auto const pool_thread = worker.get();
+
+        std::promise<int> later;
+        std::future<std::thread::id> ran_on;
+        {
+            sib::executor::scope const scope{&pool};
+            ran_on = later.get_future() | then([](int) { return std::this_thread::get_id(); });
+        }
+        later.set_value(1);
+        CHECK((std::move(ran_on) | get()) == pool_thread);
+        // The reactor may still be returning from submit: keep the pool alive until it has.
+        while (sib::future_reactor::global().size() != 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    SECTION("when_any")
+    {
+        std::promise<std::string> slow;
+        auto first = (in::parallel ^ slow.get_future() ^ ready("Fast"s)) | get();
+        CHECK(first == "Fast"s);
+        slow.set_value("Slow");
+
+        std::promise<std::string> lhs;
+        auto preferred = when_any(in::sequence, lhs.get_future(), ready("Right"s));
+        lhs.set_value("Left");
+        CHECK((std::move(preferred) | get()) == "Left"s);
+
+        CHECK((when_any(in::sequence, failed<std::string>(), ready("Right"s)) | get()) == "Right"s);
+        CHECK((when_any(in::parallel, failed<std::string>(), ready("Right"s).share()) | get()) == "Right"s);
+        CHECK_THROWS_AS(when_any(in::parallel, failed<int>(), failed<int>()) | get(), std::runtime_error);
+    }
+
+    SECTION("when_all")
+    {
+        std::promise<int> one;
+        std::promise<std::string> two;
+        auto both = when_all(in::parallel, one.get_future(), two.get_future(), ready(3.0).share());
+        two.set_value("two");
+        one.set_value(1);
+        CHECK((std::move(both) | get()) == std::make_tuple(1, "two"s, 3.0));
+
+        CHECK_THROWS_AS(when_all(ready(1), failed<int>()) | get(), std::runtime_error);
+    }
+
+    SECTION("many futures share one thread")
+    {
+        std::promise<void> gate;
+        auto const opened = gate.get_future().share();
+        std::vector<std::future<int>> results;
+        for (int i = 0; i < 1000; ++i) {
+            results.push_back(opened | then([i] { return i; }));
+        }
+        CHECK(sib::future_reactor::global().size() >= 1000);
+        gate.set_value();
+        int total = 0;
+        for (auto& result : results) {
+            total += std::move(result) | get();
+        }
+        CHECK(total == 999 * 1000 / 2);
+    }
+}
@@ -0,0 +1,67 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/future_reactor.h"
+#include <thread>
+
+TEST_CASE("Test future_reactor")
+{
+    SECTION("ready futures call back at once")
+    {
+        sib::future_reactor reactor;
+        std::promise<int> promise;
+        promise.set_value(1);
+        std::thread::id called_on;
+        reactor.when_ready(promise.get_future(), [&called_on](std::future<int> f) {
+            CHECK(f.get() == 1);
+            called_on = std::this_thread::get_id();
+        });
+        CHECK(called_on == std::this_thread::get_id());
+        CHECK(reactor.size() == 0);
+    }
+
+    SECTION("pending futures call back from the reactor")
+    {
+        sib::future_reactor reactor;
+        std::promise<int> promise;
+        std::promise<std::thread::id> called_on;
+        reactor.when_ready(promise.get_future(), [&called_on](std::future<int> f) {
+            CHECK(f.get() == 2);
+            called_on.set_value(std::this_thread::get_id());
+        });
+        CHECK(reactor.size() == 1);
+        promise.set_value(2);
+        CHECK(called_on.get_future().get() != std::this_thread::get_id());
+    }
+
+    SECTION("notified futures call back without waiting for the next poll")
+    {
+        using namespace std::chrono_literals;
+        sib::future_reactor reactor{1s, 1s};
+        std::promise<int> promise;
+        std::promise<void> called;
+        reactor.when_ready(promise.get_future(), [&called](std::future<int>) { called.set_value(); });
+        // Let the reactor poll once and go back to sleep.
+        std::this_thread::sleep_for(20ms);
+        promise.set_value(3);
+        reactor.notify();
+        CHECK(called.get_future().wait_for(500ms) == std::future_status::ready);
+    }
+
+    SECTION("abandoned callbacks are dropped")
+    {
+        std::promise<int> never;
+        std::promise<int> relay;
+        auto broken = relay.get_future();
+        {
+            sib::future_reactor reactor;
+            reactor.when_ready(never.get_future(), [relay = std::move(relay)](std::future<int>) mutable {
+                relay.set_value(0);
+            });
+        }
+        CHECK_THROWS_AS(broken.get(), std::future_error);
+    }
+}
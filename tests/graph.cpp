@@ -0,0 +1,101 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/monad/graph.h"
+#include <stdexcept>
+#include <string>
+
+TEST_CASE("Test task graphs")
+{
+    using namespace sib::monad;
+    using namespace std::string_literals;
+
+    sib::thread_pool pool{4};
+    graph g;
+    std::atomic<int> calls{0};
+
+    auto const hello = g.node([&calls] { ++calls; return "Hello"s; });
+    auto const world = g.node([] { return "World!"s; });
+
+    SECTION("node | get()")
+    {
+        g.run(pool);
+        CHECK((hello | get()) == "Hello"s);
+        CHECK((world | get()) == "World!"s);
+    }
+
+    SECTION("node | then(...)")
+    {
+        auto const greeting = hello | then([](auto const& s) { return s + ", World!"s; });
+        g.run(pool);
+        CHECK((greeting | get()) == "Hello, World!"s);
+    }
+
+    SECTION("diamond dependencies run once")
+    {
+        auto const lower = hello | then([](std::string s) { s[0] = 'h'; return s; });
+        auto const upper = hello | then([](std::string s) { s[1] = 'E'; return s; });
+        auto const both = when_all(lower, upper) | apply([](auto const& l, auto const& u) { return l + u; });
+
+        g.run(pool);
+        CHECK((both | get()) == "helloHEllo"s);
+        CHECK(calls == 1);
+
+        // A graph may be run again
+        g.run(pool);
+        CHECK((both | get()) == "helloHEllo"s);
+        CHECK(calls == 2);
+    }
+
+    SECTION("when_all(node...) | apply(...)")
+    {
+        auto const there = g.node([] { return "there"s; });
+        auto const merge = [](std::string const& x, std::string const& y, std::string const& z) {
+            return x + ", "s + y + ", "s + z;
+        };
+        auto const merged = (in::parallel & hello & there & world) | apply(merge);
+        g.run(pool);
+        CHECK((merged | get()) == "Hello, there, World!"s);
+    }
+
+    SECTION("when_any(node...)")
+    {
+        auto const except = g.node([]() -> std::string { throw std::runtime_error{"Exception!"}; });
+
+        auto const hello_or_world = when_any(hello, world);
+        auto const except_or_hello = in::parallel ^ except ^ hello;
+        auto const except_or_except = in::parallel ^ except ^ except;
+        g.run(pool);
+
+        auto const result = hello_or_world | get();
+        CHECK((result == "Hello"s || result == "World!"s));
+        CHECK((except_or_hello | get()) == "Hello"s);
+        CHECK_THROWS_AS(except_or_except | get(), std::runtime_error);
+    }
+
+    SECTION("exceptions propagate to dependents")
+    {
+        auto const except = g.node([]() -> int { throw std::runtime_error{"Exception!"}; });
+        auto const dependent = except | then([](int x) { return x + 1; });
+        g.run(pool);
+        CHECK_THROWS_AS(dependent | get(), std::runtime_error);
+        CHECK((hello | get()) == "Hello"s);
+    }
+
+    SECTION("wide graph")
+    {
+        std::vector<graph_node<int>> leaves;
+        for (int i = 0; i < 100; ++i) {
+            leaves.push_back(g.node([i] { return i; }));
+        }
+        auto sum = leaves[0];
+        for (int i = 1; i < 100; ++i) {
+            sum = (in::parallel & sum & leaves[i]) | apply(std::plus<>{});
+        }
+        g.run(pool);
+        CHECK((sum | get()) == 4950);
+    }
+}
@@ -0,0 +1,131 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#include "instrumentation.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local sib::test::allocation_counts counts;
+
+void* allocate(std::size_t size)
+{
+    ++counts.allocations;
+    counts.bytes += size;
+    if (auto* const p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void* allocate(std::size_t size, std::align_val_t alignment)
+{
+    ++counts.allocations;
+    counts.bytes += size;
+    auto const align = static_cast<std::size_t>(alignment);
+    // aligned_alloc needs the size to be a multiple of the alignment.
+    if (auto* const p = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void deallocate(void* p) noexcept
+{
+    if (p) {
+        ++counts.deallocations;
+        std::free(p);
+    }
+}
+
+}
+
+namespace sib::test::detail {
+
+allocation_counts thread_allocations() noexcept
+{
+    return counts;
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, alignment);
+}
+
+void operator delete(void* p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+    deallocate(p);
+}
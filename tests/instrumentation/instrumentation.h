@@ -0,0 +1,121 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "sib/executor.h"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+/*
+ * Instrumentation for pinning the cost of the library's combinators in tests.
+ * Linking it replaces the global operator new and delete with counting versions.
+ */
+namespace sib::test {
+
+struct allocation_counts
+{
+    std::size_t allocations = 0;
+    std::size_t deallocations = 0;
+    std::size_t bytes = 0;
+};
+
+namespace detail {
+
+// Totals for the calling thread since it started.
+allocation_counts thread_allocations() noexcept;
+
+}
+
+/*
+ * Counts the heap allocations made by the calling thread during the counter's lifetime.
+ * Other threads' allocations (e.g. by spawned work) are not included.
+ */
+class allocation_counter
+{
+private:
+    allocation_counts start;
+
+public:
+    allocation_counter() noexcept :
+        start{detail::thread_allocations()}
+    {}
+
+    allocation_counts counts() const noexcept
+    {
+        auto const now = detail::thread_allocations();
+        return {now.allocations - start.allocations, now.deallocations - start.deallocations, now.bytes - start.bytes};
+    }
+
+    std::size_t allocations() const noexcept
+    {
+        return counts().allocations;
+    }
+};
+
+/*
+ * Counts the jobs passed to sib::spawn, and the threads started for them, by the calling thread during the counter's
+ * lifetime, including those spawned in turn by the spawned jobs.
+ * It is a tracker, so replaces any sib::monad::scope in force.
+ */
+class spawn_counter
+{
+private:
+    class State : public tracker
+    {
+    public:
+        std::atomic<std::size_t> spawns{0};
+        std::atomic<std::size_t> threads{0};
+        std::weak_ptr<State> self;
+
+        std::function<void()> track(std::function<void()> job) override
+        {
+            spawns.fetch_add(1, std::memory_order_relaxed);
+            return [state = self.lock(), job = std::move(job)] {
+                tracker::scope const scope{state.get()};
+                job();
+            };
+        }
+
+        void launch(std::function<void()> job) override
+        {
+            threads.fetch_add(1, std::memory_order_relaxed);
+            tracker::launch(std::move(job));
+        }
+    };
+
+    std::shared_ptr<State> state;
+    tracker::scope current;
+
+    static std::shared_ptr<State> make()
+    {
+        auto state = std::make_shared<State>();
+        state->self = state;
+        return state;
+    }
+
+public:
+    spawn_counter() :
+        state{make()},
+        current{state.get()}
+    {}
+
+    spawn_counter(spawn_counter const&) = delete;
+    spawn_counter& operator=(spawn_counter const&) = delete;
+
+    std::size_t spawns() const noexcept
+    {
+        return state->spawns.load(std::memory_order_relaxed);
+    }
+
+    std::size_t threads() const noexcept
+    {
+        return state->threads.load(std::memory_order_relaxed);
+    }
+};
+
+}
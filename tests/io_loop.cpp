@@ -0,0 +1,251 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/io_loop.h"
+#include "sib/monad/future.h"
+#include <array>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/un.h>
+
+using namespace std::string_literals;
+
+namespace {
+
+// A non-blocking pipe, closed on destruction.
+struct Pipe
+{
+    int read;
+    int write;
+
+    Pipe()
+    {
+        int fds[2];
+        REQUIRE(::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+        read = fds[0];
+        write = fds[1];
+    }
+
+    Pipe(Pipe const&) = delete;
+    Pipe& operator=(Pipe const&) = delete;
+
+    ~Pipe()
+    {
+        ::close(read);
+        ::close(write);
+    }
+
+    void send(std::string const& s) const
+    {
+        REQUIRE(::write(write, s.data(), s.size()) == static_cast<ssize_t>(s.size()));
+    }
+};
+
+}
+
+TEST_CASE("Test io_loop")
+{
+    using namespace sib::monad;
+    using namespace std::chrono_literals;
+
+    sib::io_loop loop;
+
+    SECTION("reads complete when data arrives")
+    {
+        Pipe pipe;
+        std::array<char, 16> buffer{};
+        auto read = loop.read(pipe.read, buffer.data(), buffer.size());
+        CHECK(read.wait_for(10ms) == std::future_status::timeout);
+        CHECK(loop.pending() == 1);
+        pipe.send("Hello");
+        CHECK((std::move(read) | get()) == 5);
+        CHECK(std::string(buffer.data(), 5) == "Hello"s);
+        CHECK(loop.pending() == 0);
+    }
+
+    SECTION("reads in order, and end of file")
+    {
+        Pipe pipe;
+        std::array<char, 1> first{};
+        std::array<char, 1> second{};
+        auto a = loop.read(pipe.read, first.data(), 1);
+        auto b = loop.read(pipe.read, second.data(), 1);
+        pipe.send("AB");
+        CHECK((std::move(a) | get()) == 1);
+        CHECK((std::move(b) | get()) == 1);
+        CHECK(first[0] == 'A');
+        CHECK(second[0] == 'B');
+
+        auto eof = loop.read(pipe.read, first.data(), 1);
+        ::close(pipe.write);
+        pipe.write = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+        CHECK((std::move(eof) | get()) == 0);
+    }
+
+    SECTION("writes and then")
+    {
+        int fds[2];
+        REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == 0);
+        std::string const message = "ping";
+        std::array<char, 16> buffer{};
+        auto reply = loop.read(fds[1], buffer.data(), buffer.size())
+                   | then([&buffer](std::size_t n) { return std::string(buffer.data(), n); });
+        CHECK((loop.write(fds[0], message.data(), message.size()) | get()) == 4);
+        CHECK((std::move(reply) | get()) == "ping"s);
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    SECTION("accept")
+    {
+        auto const listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        // An abstract socket, so that there is no file to clean up.
+        auto const name = "\0sib_io_loop_test_"s + std::to_string(::getpid());
+        std::copy(name.begin(), name.end(), address.sun_path);
+        auto const length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + name.size());
+        REQUIRE(::bind(listener, reinterpret_cast<sockaddr*>(&address), length) == 0);
+        REQUIRE(::listen(listener, 4) == 0);
+
+        auto accepted = loop.accept(listener);
+        auto const client = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        REQUIRE(::connect(client, reinterpret_cast<sockaddr*>(&address), length) == 0);
+        auto const server = std::move(accepted) | get();
+        CHECK(server >= 0);
+        CHECK((::fcntl(server, F_GETFL) & O_NONBLOCK) != 0);
+        ::close(server);
+        ::close(client);
+        ::close(listener);
+    }
+
+    SECTION("timers")
+    {
+        auto const start = std::chrono::steady_clock::now();
+        auto later = loop.after(20ms);
+        auto sooner = loop.after(5ms);
+        std::move(sooner) | get();
+        CHECK(later.wait_for(0s) == std::future_status::timeout);
+        std::move(later) | get();
+        CHECK(std::chrono::steady_clock::now() - start >= 20ms);
+    }
+
+    SECTION("completions notify the reactor")
+    {
+        // A reactor that only polls every second, so only a notification gets the read's callback run in time.
+        sib::future_reactor reactor{1s, 1s};
+        sib::io_loop notifying{reactor};
+        Pipe pipe;
+        std::array<char, 16> buffer{};
+        std::promise<std::size_t> read;
+        reactor.when_ready(notifying.read(pipe.read, buffer.data(), buffer.size()), [&read](std::future<std::size_t> f) {
+            read.set_value(f.get());
+        });
+        std::this_thread::sleep_for(20ms);
+        pipe.send("Hello");
+        auto result = read.get_future();
+        REQUIRE(result.wait_for(500ms) == std::future_status::ready);
+        CHECK(result.get() == 5);
+    }
+
+    SECTION("the first of several replicas")
+    {
+        std::vector<std::unique_ptr<Pipe>> replicas;
+        std::vector<std::array<char, 16>> buffers(3);
+        for (int i = 0; i < 3; ++i) {
+            replicas.push_back(std::make_unique<Pipe>());
+        }
+        auto const reply = [&](int i) {
+            return loop.read(replicas[i]->read, buffers[i].data(), buffers[i].size())
+                 | then([&buffers, i](std::size_t n) { return std::string(buffers[i].data(), n); });
+        };
+        auto first = when_any(in::parallel, reply(0), reply(1), reply(2), loop.after(5s) | then([] { return "timeout"s; }));
+        replicas[1]->send("one");
+        CHECK((std::move(first) | get()) == "one"s);
+        for (auto const& replica : replicas) {
+            loop.cancel(replica->read);
+        }
+    }
+
+    SECTION("when_all")
+    {
+        Pipe a;
+        Pipe b;
+        std::array<char, 4> abuf{};
+        std::array<char, 4> bbuf{};
+        auto both = when_all(loop.read(a.read, abuf.data(), abuf.size()), loop.read(b.read, bbuf.data(), bbuf.size()));
+        b.send("bb");
+        a.send("a");
+        CHECK((std::move(both) | get()) == std::make_tuple(std::size_t{1}, std::size_t{2}));
+    }
+
+    SECTION("many waits, one thread")
+    {
+        std::vector<std::unique_ptr<Pipe>> pipes;
+        std::vector<char> buffers(200);
+        std::vector<std::future<std::size_t>> reads;
+        for (std::size_t i = 0; i < buffers.size(); ++i) {
+            pipes.push_back(std::make_unique<Pipe>());
+            reads.push_back(loop.read(pipes.back()->read, &buffers[i], 1));
+        }
+        CHECK(loop.pending() == buffers.size());
+        for (auto const& pipe : pipes) {
+            pipe->send("x");
+        }
+        for (auto& read : reads) {
+            CHECK((std::move(read) | get()) == 1);
+        }
+    }
+
+    SECTION("failures")
+    {
+        Pipe pipe;
+        char c;
+        CHECK_THROWS_AS(loop.read(pipe.write, &c, 1) | get(), std::system_error);
+
+        auto waiting = loop.read(pipe.read, &c, 1);
+        loop.cancel(pipe.read);
+        CHECK_THROWS_AS(std::move(waiting) | get(), std::system_error);
+        CHECK(loop.pending() == 0);
+
+        std::future<std::size_t> orphan;
+        {
+            sib::io_loop temporary;
+            orphan = temporary.read(pipe.read, &c, 1);
+        }
+        CHECK_THROWS_AS(std::move(orphan) | get(), std::system_error);
+    }
+
+    SECTION("writes to a closed pipe fail with EPIPE rather than raising SIGPIPE")
+    {
+        // Were SIGPIPE raised, its default action would end the test.
+        char const c = 'x';
+        int fds[2];
+        REQUIRE(::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+        ::close(fds[0]);
+        int code = 0;
+        try {
+            loop.write(fds[1], &c, 1) | get();
+        } catch (std::system_error const& e) {
+            code = e.code().value();
+        }
+        CHECK(code == EPIPE);
+        ::close(fds[1]);
+
+        REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == 0);
+        ::close(fds[1]);
+        code = 0;
+        try {
+            loop.write(fds[0], &c, 1) | get();
+        } catch (std::system_error const& e) {
+            code = e.code().value();
+        }
+        CHECK(code == EPIPE);
+        ::close(fds[0]);
+    }
+}
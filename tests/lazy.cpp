@@ -0,0 +1,121 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "instrumentation/instrumentation.h"
+#include "sib/monad/lazy.h"
+#include "sib/monad/task.h"
+#include <array>
+#include <optional>
+#include <string>
+#include <thread>
+
+using namespace std::string_literals;
+
+TEST_CASE("Test lazy")
+{
+    using namespace sib::monad;
+
+    int calls = 0;
+    auto const hello = [&calls] {
+        ++calls;
+        return "Hello"s;
+    };
+
+    SECTION("lazy | get() computes once, on first access")
+    {
+        lazy<std::string> const value{hello};
+        CHECK(!value.ready());
+        CHECK(calls == 0);
+        CHECK((value | get()) == "Hello"s);
+        CHECK((value | get()) == "Hello"s);
+        CHECK(value.ready());
+        CHECK(calls == 1);
+
+        lazy deduced{[] { return 42; }};
+        static_assert(std::is_same_v<decltype(deduced), lazy<int>>);
+        CHECK((std::move(deduced) | get()) == 42);
+    }
+
+    SECTION("exceptions are remembered")
+    {
+        lazy<int> const failing{[&calls]() -> int {
+            ++calls;
+            throw std::runtime_error{"Exception!"};
+        }};
+        CHECK_THROWS_AS(failing | get(), std::runtime_error);
+        CHECK_THROWS_AS(failing | get(), std::runtime_error);
+        CHECK(calls == 1);
+    }
+
+    SECTION("a value needed to compute itself")
+    {
+        lazy<int>* self = nullptr;
+        lazy<int> cyclic{[&self] { return self->value() + 1; }};
+        self = &cyclic;
+        CHECK_THROWS_AS(cyclic | get(), std::logic_error);
+    }
+
+    SECTION("small callables do not allocate")
+    {
+        sib::test::allocation_counter const counter;
+        std::array<int, 3> const numbers{1, 2, 3};
+        lazy<int> const sum{[numbers] { return numbers[0] + numbers[1] + numbers[2]; }};
+        CHECK((sum | get()) == 6);
+        CHECK(counter.allocations() == 0);
+
+        // Nor does composing small lazies with small callables, or with each other.
+        auto twice = lazy<int>{[numbers] { return numbers[0] + numbers[1] + numbers[2]; }} | then([](int i) { return 2 * i; });
+        CHECK((std::move(twice) | get()) == 12);
+        // std::runtime_error would allocate its message, so throw something that does not.
+        auto const fail = []() -> int { throw std::bad_optional_access{}; };
+        CHECK((when_any(lazy<int>{fail}, lazy<int>{[numbers] { return numbers[0]; }}) | get()) == 1);
+        CHECK(counter.allocations() == 0);
+    }
+
+    SECTION("lazy | then(f)")
+    {
+        auto greeting = lazy<std::string>{hello} | then([](auto const& s) { return s + ", World!"s; });
+        static_assert(std::is_same_v<decltype(greeting), lazy<std::string>>);
+        CHECK(calls == 0);
+        CHECK((std::move(greeting) | get()) == "Hello, World!"s);
+        CHECK(calls == 1);
+
+        auto nested = lazy<int>{[] { return 1; }} | then([](int i) { return lazy<int>{[i] { return i + 1; }}; });
+        static_assert(std::is_same_v<decltype(nested), lazy<int>>);
+        CHECK((std::move(nested) | get()) == 2);
+    }
+
+    SECTION("when_any")
+    {
+        auto const fail = []() -> std::string { throw std::runtime_error{"Exception!"}; };
+        CHECK((when_any(lazy<std::string>{fail}, lazy<std::string>{hello}) | get()) == "Hello"s);
+        CHECK((when_any(lazy<std::string>{hello}, lazy<std::string>{fail}) | get()) == "Hello"s);
+        CHECK_THROWS_AS(when_any(lazy<std::string>{fail}, lazy<std::string>{fail}) | get(), std::runtime_error);
+
+        // Operands after the first success are never computed.
+        CHECK((when_any(lazy<std::string>{hello}, lazy<std::string>{hello}) | get()) == "Hello"s);
+        CHECK(calls == 3);
+    }
+
+    SECTION("when_all")
+    {
+        auto all = when_all(lazy<std::string>{hello}, lazy<int>{[] { return 2; }}, lazy<double>{[] { return 3.0; }});
+        CHECK(calls == 0);
+        CHECK((std::move(all) | get()) == std::make_tuple("Hello"s, 2, 3.0));
+    }
+
+    SECTION("lazy | share()")
+    {
+        auto const shared = lazy<std::string>{hello} | sib::share();
+        static_assert(std::is_same_v<decltype(shared), sib::shared_task<std::string()> const>);
+        std::string other;
+        std::thread thread{[&shared, &other] { other = shared | get(); }};
+        CHECK((shared | get()) == "Hello"s);
+        thread.join();
+        CHECK(other == "Hello"s);
+        CHECK(calls == 1);
+    }
+}
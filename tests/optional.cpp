@@ -6,6 +6,43 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "sib/monad/optional.h"
+#include <any>
+#include <array>
+#include <tuple>
+
+namespace {
+
+// Counts how often values of this type are copied and moved.
+struct Counted
+{
+    static inline int copies = 0;
+    static inline int moves = 0;
+
+    int value;
+
+    explicit Counted(int value) : value{value} {}
+    Counted(Counted const& rhs) : value{rhs.value} { ++copies; }
+    Counted(Counted&& rhs) noexcept : value{rhs.value} { ++moves; }
+
+    static void reset()
+    {
+        copies = 0;
+        moves = 0;
+    }
+};
+
+// Accepts any argument at all, but only keeps the value of an int.
+struct Greedy
+{
+    int value;
+
+    explicit Greedy(int value) : value{value} {}
+
+    template<typename U, typename = std::enable_if_t<!std::is_same_v<std::decay_t<U>, Greedy>>>
+    Greedy(U&&) : value{-1} {}
+};
+
+}
 
 TEST_CASE("Test monadic operations on std::optional")
 {
@@ -69,6 +106,30 @@ TEST_CASE("Test monadic operations on std::optional")
         CHECK((empty | then(f)) == empty);
     }
 
+    SECTION("optional | then(...) constructs its result in place")
+    {
+        Counted::reset();
+        auto const value = std::optional<int>{1} | then([](int x) { return Counted{x}; });
+        auto const flattened = value | then([](Counted const& c) { return std::optional<Counted>{std::in_place, c.value + 1}; });
+        CHECK(Counted::copies == 0);
+        CHECK(Counted::moves == 0);
+        CHECK(flattened->value == 2);
+    }
+
+    SECTION("optional | then(...) returning a type that accepts any argument")
+    {
+        // std::any would happily store whatever was used to construct it in place, so it must be given the result
+        auto const value = std::optional<int>{1} | then([](int x) -> std::any { return x + 1; });
+        static_assert(std::is_same_v<decltype(value), std::optional<std::any> const>);
+        REQUIRE(value);
+        CHECK(std::any_cast<int>(*value) == 2);
+
+        // Nor should a class with a converting constructor template be given anything but the result
+        auto const greedy = std::optional<int>{1} | then([](int x) { return Greedy{x + 1}; });
+        REQUIRE(greedy);
+        CHECK(greedy->value == 2);
+    }
+
     SECTION("when_any(optional...)")
     {
         CHECK(when_any(empty, opt, copt) != empty);
@@ -94,10 +155,112 @@ TEST_CASE("Test monadic operations on std::optional")
         CHECK(((in::sequence & opt & copt & opt) | apply(plus3) | get()) == 111);
     }
 
+    SECTION("when_all(optional...) copies or moves each value once")
+    {
+        std::optional<Counted> a{std::in_place, 1};
+        std::optional<Counted> b{std::in_place, 2};
+        std::optional<Counted> c{std::in_place, 3};
+        std::optional<Counted> const none = std::nullopt;
+
+        Counted::reset();
+        auto const copied = when_all(a, b, c);
+        CHECK(Counted::copies == 3);
+        CHECK(Counted::moves == 0);
+        CHECK(std::get<2>(*copied).value == 3);
+
+        Counted::reset();
+        auto const moved = when_all(in::parallel, std::move(a), std::move(b), std::move(c));
+        CHECK(Counted::copies == 0);
+        CHECK(Counted::moves == 3);
+        CHECK(std::get<0>(*moved).value == 1);
+
+        // Nothing is copied if any operand is empty
+        Counted::reset();
+        std::optional<Counted> const d{std::in_place, 4};
+        CHECK(when_all(d, d, none) == std::nullopt);
+        CHECK(Counted::copies == 0);
+
+        // Operator chains never copy rvalue operands
+        Counted::reset();
+        std::ignore = in::sequence & std::optional<Counted>{std::in_place, 1} & std::optional<Counted>{std::in_place, 2};
+        CHECK(Counted::copies == 0);
+    }
+
     SECTION("(((empty ^ opt) | then(f)) & copt) | apply(minus)")
     {
         // A complex expression using all the (public) monadic operations
         CHECK(((in::sequence & ((in::parallel ^ empty ^ opt) | then(f)) & copt) | apply(std::minus<>{}) | get()) == 57);
     }
+}
+
+namespace {
+
+using sib::monad::operator|;
+using sib::monad::operator^;
+using sib::monad::operator&;
+
+// Parses a decimal digit, as a config validator might.
+constexpr std::optional<int> digit(char c)
+{
+    return c >= '0' && c <= '9' ? std::optional<int>{c - '0'} : std::nullopt;
+}
+
+// A table built at compile time by the same pipelines as would run at run time.
+template<std::size_t N>
+constexpr std::array<std::optional<int>, N> squares_of_digits(char const (&text)[N])
+{
+    using namespace sib::monad;
+    std::array<std::optional<int>, N> table{};
+    for (std::size_t i = 0; i < N; ++i) {
+        table[i] = digit(text[i]) | then([](int d) { return d * d; });
+    }
+    return table;
+}
 
 }
+
+TEST_CASE("Test monadic operations on std::optional in constant expressions")
+{
+    using namespace sib::monad;
+
+    constexpr std::optional<int> opt = 42;
+    constexpr std::optional<int> empty = std::nullopt;
+    constexpr auto twice = [](int x) { return x + x; };
+
+    SECTION("the tags")
+    {
+        static_assert(then(twice)(21) == 42);
+        static_assert(apply(std::plus<>{})(std::make_tuple(20, 22)) == 42);
+        static_assert(std::get<0>(get(42).args) == 42);
+        static_assert(identity(42) == 42);
+        static_assert(make_tuple(42) == std::make_tuple(42));
+    }
+
+    SECTION("get, flatten and then")
+    {
+        static_assert((opt | get()) == 42);
+        static_assert((std::optional<std::optional<int>>{opt} | flatten() | get()) == 42);
+        static_assert((opt | then(twice) | get()) == 84);
+        static_assert((opt | then(digit)) == std::nullopt);
+        static_assert((empty | then(twice)) == std::nullopt);
+    }
+
+    SECTION("when_any and when_all")
+    {
+        static_assert(when_any(empty, opt) == opt);
+        static_assert((in::sequence ^ std::optional<int>{} ^ std::optional<int>{7}).value == 7);
+        static_assert((when_all(opt, std::optional<int>{27}) | apply(std::plus<>{}) | get()) == 69);
+        static_assert(((in::sequence & opt & opt & opt) | apply([](int a, int b, int c) { return a + b + c; }) | get()) == 126);
+        static_assert((in::sequence & opt & empty).value == std::nullopt);
+    }
+
+    SECTION("precomputed tables")
+    {
+        constexpr auto table = squares_of_digits("1x3");
+        static_assert(table[0] == 1);
+        static_assert(table[1] == std::nullopt);
+        static_assert(table[2] == 9);
+        static_assert(table[3] == std::nullopt);
+        CHECK(table[2] == 9);
+    }
+}
@@ -0,0 +1,157 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/persistent_cache.h"
+#include "sib/monad/task.h"
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+
+struct Point
+{
+    int x;
+    int y;
+};
+
+struct Named
+{
+    std::string name;
+};
+
+}
+
+template<>
+struct sib::serializer<Named>
+{
+    static void save(Named const& value, std::vector<unsigned char>& out)
+    {
+        sib::serializer<std::string>::save(value.name, out);
+    }
+
+    static Named load(unsigned char const* data, std::size_t size)
+    {
+        return {sib::serializer<std::string>::load(data, size)};
+    }
+};
+
+TEST_CASE("Test persistent_cache")
+{
+    using namespace sib::monad;
+
+    auto const path = (std::filesystem::temp_directory_path() / "sib_persistent_cache_test.bin").string();
+    std::filesystem::remove(path);
+    int computed = 0;
+    auto const table = [&computed] {
+        ++computed;
+        std::vector<int> squares;
+        for (int i = 0; i < 1000; ++i) {
+            squares.push_back(i * i);
+        }
+        return squares;
+    };
+
+    SECTION("results survive a restart")
+    {
+        {
+            sib::persistent_cache cache{path, 1 << 20};
+            auto const squares = cache.memoize("squares", 1, table);
+            CHECK((squares | get())[999] == 999 * 999);
+            CHECK((squares | get())[10] == 100);
+            CHECK(computed == 1);
+        }
+        {
+            sib::persistent_cache cache{path, 1 << 20};
+            CHECK((cache.memoize("squares", 1, table) | get())[999] == 999 * 999);
+            CHECK(computed == 1);
+        }
+    }
+
+    SECTION("a new version is recomputed")
+    {
+        sib::persistent_cache cache{path, 1 << 20};
+        cache.memoize("squares", 1, table) | get();
+        cache.memoize("squares", 2, table) | get();
+        CHECK(computed == 2);
+        cache.memoize("squares", 2, table) | get();
+        CHECK(computed == 2);
+    }
+
+    SECTION("find returns the stored value in place")
+    {
+        {
+            sib::persistent_cache cache{path, 1 << 20};
+            CHECK(cache.find<Point>("origin", 1) == nullptr);
+            CHECK((cache.memoize("origin", 1, [] { return Point{3, 4}; }) | get()).y == 4);
+            auto const array = cache.memoize("array", 1, [] { return std::array<double, 4>{1, 2, 3, 4}; }) | get();
+            CHECK(array[3] == 4);
+        }
+        sib::persistent_cache cache{path, 1 << 20};
+        auto const* const point = cache.find<Point>("origin", 1);
+        REQUIRE(point != nullptr);
+        CHECK(point->x == 3);
+        CHECK(point->y == 4);
+        CHECK(cache.find<Point>("origin", 2) == nullptr);
+        CHECK(cache.find<long long>("origin", 1) == nullptr);
+        auto const* const array = cache.find<std::array<double, 4>>("array", 1);
+        REQUIRE(array != nullptr);
+        CHECK((*array)[2] == 3);
+    }
+
+    SECTION("types holding addresses are not stored by their bytes")
+    {
+        static_assert(sib::holds_addresses<int*>::value);
+        static_assert(sib::holds_addresses<std::string Named::*>::value);
+        static_assert(sib::holds_addresses<std::string_view>::value);
+        static_assert(!sib::holds_addresses<std::array<double, 4>>::value);
+    }
+
+    SECTION("user serializers")
+    {
+        {
+            sib::persistent_cache cache{path, 1 << 20};
+            CHECK((cache.memoize("name", 1, [] { return Named{"Hello"}; }) | get()).name == "Hello"s);
+        }
+        sib::persistent_cache cache{path, 1 << 20};
+        CHECK((cache.memoize("name", 1, [] { return Named{"World"}; }) | get()).name == "Hello"s);
+    }
+
+    SECTION("a full cache still computes")
+    {
+        sib::persistent_cache cache{path, 4096};
+        auto const squares = cache.memoize("squares", 1, table);
+        CHECK((squares | get()).size() == 1000);
+        CHECK(cache.size() <= 4096);
+        CHECK((cache.memoize("squares", 1, table) | get()).size() == 1000);
+        CHECK(computed == 2);
+    }
+
+    SECTION("an unrecognised file is started afresh")
+    {
+        {
+            std::ofstream junk{path, std::ios::binary};
+            junk << "This is not a cache";
+        }
+        sib::persistent_cache cache{path, 1 << 20};
+        CHECK(cache.size() == 64);
+        CHECK((cache.memoize("squares", 1, table) | get()).size() == 1000);
+        CHECK(computed == 1);
+    }
+
+    SECTION("failure to open throws")
+    {
+        CHECK_THROWS_AS(sib::persistent_cache{"/nonexistent/directory/cache.bin"}, std::system_error);
+    }
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,127 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/monad/pipeline.h"
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+TEST_CASE("Test pipelines of then stages")
+{
+    using namespace sib::monad;
+    using namespace std::string_literals;
+
+    std::vector<int> numbers(1000);
+    std::iota(numbers.begin(), numbers.end(), 0);
+
+    auto const twice = [](int x) { return 2 * x; };
+    auto const plus_one = [](int x) { return x + 1; };
+    auto const to_string = [](int x) { return std::to_string(x); };
+
+    std::vector<std::string> expected;
+    for (auto n : numbers) {
+        expected.push_back(std::to_string(2 * n + 1));
+    }
+
+    SECTION("pipeline(in::sequence) | then(...) | get(range)")
+    {
+        auto const p = pipeline(in::sequence) | then(twice) | then(plus_one) | then(to_string);
+        static_assert(std::is_same_v<decltype(p | get(numbers)), std::vector<std::string>>);
+        CHECK((p | get(numbers)) == expected);
+    }
+
+    SECTION("pipeline(in::parallel) | then(...) | get(range)")
+    {
+        auto const p = pipeline(in::parallel, 4) | then(twice) | then(plus_one) | then(to_string);
+        CHECK((p | get(numbers)) == expected);
+
+        // A pipeline may be run more than once
+        CHECK((p | get(std::vector<int>{1, 2, 3})) == std::vector{"3"s, "5"s, "7"s});
+    }
+
+    SECTION("pipeline with no stages")
+    {
+        CHECK((pipeline(in::parallel) | get(numbers)) == numbers);
+    }
+
+    SECTION("move-only items")
+    {
+        std::vector<std::unique_ptr<int>> pointers;
+        pointers.push_back(std::make_unique<int>(1));
+        pointers.push_back(std::make_unique<int>(2));
+
+        auto const p = pipeline(in::parallel) | then([](std::unique_ptr<int> x) { *x *= 10; return x; })
+                                              | then([](std::unique_ptr<int> x) { return *x; });
+        CHECK((p | get(std::move(pointers))) == std::vector{10, 20});
+    }
+
+    SECTION("stage statistics")
+    {
+        auto const p = pipeline(in::parallel) | then(twice) | then(to_string);
+        std::ignore = p | get(numbers);
+
+        auto const& stats = p.stats();
+        CHECK(stats.size() == 2);
+        CHECK(stats[0].items == numbers.size());
+        CHECK(stats[1].items == numbers.size());
+    }
+
+    SECTION("concurrent runs keep their own statistics")
+    {
+        auto const p = pipeline(in::parallel) | then(twice) | then(to_string);
+        auto const copy = p;
+        std::thread other{[&] { std::ignore = copy | get(numbers); }};
+        std::ignore = p | get(std::vector<int>{1, 2, 3});
+        other.join();
+
+        // Whichever run completed last, its counts are whole rather than a mixture of the two
+        auto const stats = p.stats();
+        CHECK((stats[0].items == 3 || stats[0].items == numbers.size()));
+        CHECK(stats[1].items == stats[0].items);
+    }
+
+    SECTION("exceptions propagate")
+    {
+        auto const p = pipeline(in::parallel, 2) | then(twice) | then([](int x) {
+            if (x == 200) {
+                throw std::runtime_error{"Exception!"};
+            }
+            return x;
+        }) | then(to_string);
+        CHECK_THROWS_AS(p | get(numbers), std::runtime_error);
+    }
+
+    SECTION("exceptions reading the range propagate")
+    {
+        // An input range whose iterator throws on reaching the given position
+        struct Throwing
+        {
+            struct iterator
+            {
+                int position;
+                int limit;
+
+                int operator*() const { return position; }
+                bool operator!=(iterator const& other) const { return position != other.position; }
+                iterator& operator++()
+                {
+                    if (++position == limit) {
+                        throw std::out_of_range{"Exception!"};
+                    }
+                    return *this;
+                }
+            };
+
+            iterator begin() const { return {0, 100}; }
+            iterator end() const { return {1000, 100}; }
+        };
+
+        Throwing const range;
+        auto const p = pipeline(in::parallel, 2) | then(twice) | then(to_string);
+        CHECK_THROWS_AS(p | get(range), std::out_of_range);
+    }
+}
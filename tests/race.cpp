@@ -0,0 +1,50 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/race.h"
+#include <vector>
+
+TEST_CASE("Test race")
+{
+    using namespace std::chrono_literals;
+
+    SECTION("the first to finish wins")
+    {
+        sib::race race;
+        CHECK(race.first() == std::nullopt);
+        CHECK(race.finish(1));
+        CHECK_FALSE(race.finish(0));
+        CHECK(race.first() == 1u);
+        CHECK(race.wait() == 1u);
+    }
+
+    SECTION("wait_for times out")
+    {
+        sib::race const race;
+        CHECK(race.wait_for(1ms) == std::nullopt);
+        CHECK(race.wait_for(1ms, 1000) == std::nullopt);
+    }
+
+    SECTION("a parked waiter is woken by the winner")
+    {
+        for (auto spin : {std::size_t{0}, std::size_t{10000}}) {
+            sib::race race;
+            std::vector<std::thread> contenders;
+            for (std::uint32_t i = 0; i < 4; ++i) {
+                contenders.emplace_back([&race, i] {
+                    std::this_thread::sleep_for(1ms);
+                    race.finish(i);
+                });
+            }
+            auto const winner = race.wait(spin);
+            CHECK(winner < 4u);
+            for (auto& contender : contenders) {
+                contender.join();
+            }
+            CHECK(race.first() == winner);
+        }
+    }
+}
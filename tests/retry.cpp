@@ -0,0 +1,204 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/fiber_executor.h"
+#include "sib/monad/function.h"
+#include "sib/monad/retry.h"
+#include "sib/monad/task.h"
+#include "sib/thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace std::string_literals;
+
+TEST_CASE("Test retry")
+{
+    using namespace sib::monad;
+
+    retry_policy quick;
+    quick.initial_delay = 100us;
+    quick.max_delay = 1ms;
+
+    int calls = 0;
+    auto const flaky = [&calls](int failures) {
+        return [&calls, failures](std::string const& name) {
+            if (++calls <= failures) {
+                throw std::runtime_error{"Exception!"};
+            }
+            return "Hello, "s + name;
+        };
+    };
+
+    SECTION("std::function | retry(policy) succeeds after failures")
+    {
+        auto const greet = std::function<std::string(std::string)>{flaky(2)} | retry(quick);
+        CHECK((greet | get("World"s)) == "Hello, World"s);
+        CHECK(calls == 3);
+    }
+
+    SECTION("packaged_task | retry(policy) succeeds after failures")
+    {
+        auto greet = std::packaged_task<std::string(std::string)>{flaky(2)} | retry(quick);
+        auto future = greet.get_future();
+        greet("World"s);
+        CHECK(future.get() == "Hello, World"s);
+        CHECK(calls == 3);
+
+        auto shared = std::packaged_task<std::string()>{[&calls] {
+            if (++calls <= 4) {
+                throw std::runtime_error{"Exception!"};
+            }
+            return "Hello"s;
+        }} | retry(quick) | sib::share();
+        CHECK((shared | get()) == "Hello"s);
+        CHECK((shared | get()) == "Hello"s);
+        CHECK(calls == 5);
+    }
+
+    SECTION("the last failure is rethrown once attempts run out")
+    {
+        quick.max_attempts = 4;
+        auto const greet = std::function<std::string(std::string)>{flaky(10)} | retry(quick);
+        CHECK_THROWS_AS(greet | get("World"s), std::runtime_error);
+        CHECK(calls == 4);
+    }
+
+    SECTION("failures that are not retryable are not retried")
+    {
+        quick.retryable = [](std::exception_ptr const& error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (std::logic_error const&) {
+                return false;
+            } catch (...) {
+                return true;
+            }
+        };
+        auto const invalid = std::function<void()>{[&calls] {
+            ++calls;
+            throw std::invalid_argument{"Invalid!"};
+        }} | retry(quick);
+        CHECK_THROWS_AS(invalid | get(), std::invalid_argument);
+        CHECK(calls == 1);
+
+        calls = 0;
+        auto const greet = std::function<std::string(std::string)>{flaky(2)} | retry(quick);
+        CHECK((greet | get("World"s)) == "Hello, World"s);
+        CHECK(calls == 3);
+    }
+
+    SECTION("an empty optional is a failure")
+    {
+        auto const maybe = std::function<std::optional<int>()>{[&calls]() -> std::optional<int> {
+            if (++calls < 3) {
+                return std::nullopt;
+            }
+            return 42;
+        }} | retry(quick);
+        CHECK((maybe | get()) == 42);
+        CHECK(calls == 3);
+
+        auto const never = std::function<std::optional<int>()>{[&calls]() -> std::optional<int> {
+            ++calls;
+            return std::nullopt;
+        }} | retry(quick);
+        CHECK(!(never | get()).has_value());
+        CHECK(calls == 6);
+    }
+
+    SECTION("backoff grows exponentially, up to max_delay, with jitter below it")
+    {
+        retry_policy policy;
+        policy.initial_delay = 1ms;
+        policy.max_delay = 10ms;
+        CHECK(policy.backoff(1) == 1ms);
+        CHECK(policy.backoff(2) == 2ms);
+        CHECK(policy.backoff(4) == 8ms);
+        CHECK(policy.backoff(5) == 10ms);
+        CHECK(policy.backoff(1000) == 10ms);
+        for (std::size_t retry = 1; retry < 100; ++retry) {
+            auto const delay = policy.delay(retry);
+            CHECK(delay >= 0ns);
+            CHECK(delay <= policy.backoff(retry));
+        }
+
+        policy.jitter = false;
+        CHECK(policy.delay(3) == 4ms);
+    }
+
+    SECTION("backing off does not hold a fiber's thread")
+    {
+        retry_policy slow;
+        slow.initial_delay = 50ms;
+        slow.jitter = false;
+
+        std::atomic<int> attempts{0};
+        std::promise<std::string> retried;
+        std::promise<int> other;
+        {
+            sib::fiber_executor fibers{1};
+            fibers.submit([&] {
+                auto const greet = std::function<std::string()>{[&attempts] {
+                    if (++attempts == 1) {
+                        throw std::runtime_error{"Exception!"};
+                    }
+                    return "Hello"s;
+                }} | retry(slow);
+                retried.set_value(greet | get());
+            });
+            while (attempts == 0) {
+                std::this_thread::yield();
+            }
+
+            // The retrying job is waiting for its backoff, but the only thread is free to run something else.
+            fibers.submit([&other] { other.set_value(42); });
+            CHECK(other.get_future().get() == 42);
+            CHECK(attempts == 1);
+            CHECK(retried.get_future().get() == "Hello"s);
+        }
+        CHECK(attempts == 2);
+    }
+
+    SECTION("started retries back off without holding a thread")
+    {
+        retry_policy slow;
+        slow.initial_delay = 100ms;
+        slow.jitter = false;
+
+        // Were each backoff to hold the pool's only thread, these would take retries * 100ms.
+        constexpr int retries = 10;
+        sib::thread_pool pool{1};
+        sib::executor::scope const scope{&pool};
+        auto const began = std::chrono::steady_clock::now();
+        std::vector<sib::shared_task<int()>> running;
+        for (int i = 0; i < retries; ++i) {
+            running.push_back(std::packaged_task<int(int)>{[attempts = std::make_shared<int>(0)](int i) {
+                if (++*attempts == 1) {
+                    throw std::runtime_error{"Exception!"};
+                }
+                return i;
+            }} | retry(slow).start(i));
+        }
+        for (int i = 0; i < retries; ++i) {
+            CHECK((running[i] | get()) == i);
+        }
+        CHECK(std::chrono::steady_clock::now() - began < retries * 100ms / 2);
+
+        slow.initial_delay = 1ms;
+        auto const never = std::packaged_task<void()>{[&calls] {
+            ++calls;
+            throw std::runtime_error{"Exception!"};
+        }} | retry(slow).start();
+        CHECK_THROWS_AS(never | get(), std::runtime_error);
+        CHECK(calls == 3);
+    }
+}
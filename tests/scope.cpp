@@ -0,0 +1,164 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/monad/scope.h"
+#include "sib/monad/task.h"
+#include "sib/thread_pool.h"
+#include <string>
+
+using namespace std::string_literals;
+
+TEST_CASE("Test scope")
+{
+    using namespace sib::monad;
+
+    SECTION("tracks and joins spawned work")
+    {
+        std::promise<void> release;
+        auto released = release.get_future().share();
+        std::atomic<bool> finished{false};
+        {
+            scope nursery;
+            sib::spawn([released, &finished] {
+                released.wait();
+                finished = true;
+            });
+            CHECK(nursery.in_flight() == 1);
+            release.set_value();
+            nursery.join();
+            CHECK(nursery.in_flight() == 0);
+            CHECK(finished);
+        }
+    }
+
+    SECTION("work spawned by tracked work is tracked too")
+    {
+        std::atomic<int> runs{0};
+        {
+            scope nursery;
+            sib::spawn([&runs] {
+                sib::spawn([&runs] {
+                    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+                    ++runs;
+                });
+                ++runs;
+            });
+        }
+        CHECK(runs == 2);
+    }
+
+    SECTION("finished threads are joined as more are started")
+    {
+        // Signals when the thread it belongs to exits, which is after the scope's thread has marked itself done.
+        struct Exit
+        {
+            std::promise<void>* exited = nullptr;
+
+            ~Exit()
+            {
+                exited->set_value();
+            }
+        };
+
+        scope nursery;
+        for (int i = 0; i < 100; ++i) {
+            std::promise<void> exited;
+            sib::spawn([&exited] {
+                thread_local Exit exit;
+                exit.exited = &exited;
+            });
+            exited.get_future().wait();
+            // The thread just started is the only one: the one before it had exited, so was joined.
+            CHECK(nursery.threads() == 1);
+        }
+        nursery.join();
+        CHECK(nursery.threads() == 0);
+    }
+
+    SECTION("when_any losers are joined")
+    {
+        std::atomic<bool> slow_finished{false};
+        std::packaged_task<std::string()> fast{[] { return "fast"s; }};
+        std::packaged_task<std::string()> slow{[&slow_finished] {
+            std::this_thread::sleep_for(std::chrono::milliseconds{20});
+            slow_finished = true;
+            return "slow"s;
+        }};
+        {
+            scope nursery;
+            CHECK(((in::parallel ^ std::move(slow) ^ std::move(fast)) | get()) == "fast"s);
+        }
+        // The loser either ran to completion or was dropped before it started, but it is not still running.
+        auto const loser_done = slow_finished.load();
+        std::this_thread::sleep_for(std::chrono::milliseconds{30});
+        CHECK(slow_finished == loser_done);
+    }
+
+    SECTION("cancel drops work that has not started")
+    {
+        sib::thread_pool pool{1};
+        sib::executor::scope const executor{&pool};
+
+        // Occupy the only worker.
+        std::promise<void> release;
+        auto released = release.get_future().share();
+        pool.submit([released] { released.wait(); });
+
+        std::atomic<bool> ran{false};
+        std::packaged_task<int()> task{[&ran] {
+            ran = true;
+            return 42;
+        }};
+        auto future = task.get_future();
+        {
+            scope nursery{scope::on_exit::cancel};
+            sib::spawn(std::move(task));
+            CHECK(nursery.in_flight() == 1);
+            nursery.cancel();
+            CHECK(nursery.cancelled());
+            release.set_value();
+        }
+        CHECK_FALSE(ran);
+        CHECK_THROWS_AS(future.get(), std::future_error);
+    }
+
+    SECTION("cancellation_requested")
+    {
+        CHECK_FALSE(scope::cancellation_requested());
+        std::promise<void> started;
+        std::promise<void> release;
+        auto released = release.get_future().share();
+        std::atomic<bool> saw_cancel{false};
+        {
+            scope nursery;
+            sib::spawn([&started, released, &saw_cancel] {
+                started.set_value();
+                released.wait();
+                saw_cancel = scope::cancellation_requested();
+            });
+            started.get_future().wait();
+            nursery.cancel();
+            release.set_value();
+        }
+        CHECK(saw_cancel);
+    }
+
+    SECTION("spawned::try_cancel")
+    {
+        sib::thread_pool pool{1};
+        sib::executor::scope const executor{&pool};
+        std::promise<void> release;
+        auto released = release.get_future().share();
+        pool.submit([released] { released.wait(); });
+
+        std::atomic<bool> ran{false};
+        auto const job = sib::spawn([&ran] { ran = true; });
+        CHECK(job.try_cancel());
+        CHECK_FALSE(job.try_run());
+        release.set_value();
+        CHECK_FALSE(ran);
+    }
+}
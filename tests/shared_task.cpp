@@ -128,5 +128,9 @@ TEST_CASE("Test monadic operations on shared_task")
         CHECK(((in::parallel & hello & world) | apply(merge) | get()) == "Hello, World!"s);
 
         CHECK((when_all(hello, world) | apply(merge) | get()) == "Hello, World!"s);
+
+        auto all = when_all(in::parallel, hello, world, hello);
+        static_assert(std::is_same_v<decltype(all), std::packaged_task<std::tuple<std::string, std::string, std::string>()>>);
+        CHECK((std::move(all) | get()) == std::make_tuple("Hello"s, "World!"s, "Hello"s));
     }
 }
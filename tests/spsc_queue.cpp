@@ -0,0 +1,55 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/spsc_queue.h"
+#include <memory>
+#include <thread>
+
+TEST_CASE("Test basic operations on spsc_queue")
+{
+    SECTION("try_push and try_pop")
+    {
+        sib::spsc_queue<int> queue{2};
+        CHECK(queue.capacity() == 2);
+        CHECK(queue.try_pop() == std::nullopt);
+
+        CHECK(queue.try_push(1));
+        CHECK(queue.try_push(2));
+        CHECK_FALSE(queue.try_push(3));
+
+        CHECK(queue.try_pop() == 1);
+        CHECK(queue.try_push(3));
+        CHECK(queue.try_pop() == 2);
+        CHECK(queue.try_pop() == 3);
+        CHECK(queue.try_pop() == std::nullopt);
+    }
+
+    SECTION("move-only values")
+    {
+        sib::spsc_queue<std::unique_ptr<int>> queue{1};
+        queue.push(std::make_unique<int>(42));
+        CHECK(*queue.pop() == 42);
+    }
+
+    SECTION("one producer, one consumer")
+    {
+        constexpr int count = 100000;
+        sib::spsc_queue<int> queue{16};
+
+        std::thread producer{[&queue]{
+            for (int i = 0; i < count; ++i) {
+                queue.push(i);
+            }
+        }};
+
+        bool in_order = true;
+        for (int i = 0; i < count; ++i) {
+            in_order = in_order && queue.pop() == i;
+        }
+        producer.join();
+        CHECK(in_order);
+    }
+}
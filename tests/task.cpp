@@ -5,6 +5,9 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "sib/monad/task.h"
+#include <array>
+#include <atomic>
+#include <memory>
 #include <string>
 
 TEST_CASE("Test monadic operations on std::packaged_task")
@@ -88,6 +91,30 @@ TEST_CASE("Test monadic operations on std::packaged_task")
         CHECK_THROWS_AS((in::parallel ^ std::move(except3) ^ std::move(except4)) | get(), std::runtime_error);
     }
 
+    SECTION("when_any(task...) over many operands")
+    {
+        auto const except = [] {
+            return std::packaged_task<std::string(std::string const&)>{[](std::string const&) -> std::string {
+                throw std::runtime_error{"Exception!"};
+            }};
+        };
+        auto const greet = [] {
+            return std::packaged_task<std::string(std::string const&)>{[](std::string const& name) { return "Hello, "s + name; }};
+        };
+        for (auto const manner : {in::sequence, in::parallel, in::automatic}) {
+            auto any = when_any(manner, except(), except(), greet(), except());
+            static_assert(std::is_same_v<decltype(any), std::packaged_task<std::string(std::string const&)>>);
+            CHECK((std::move(any) | get("World!"s)) == "Hello, World!"s);
+            CHECK_THROWS_AS(when_any(manner, except(), except(), except()) | get("World!"s), std::runtime_error);
+
+            // Losers may still run after the winner has returned, so they share the counter.
+            auto const runs = std::make_shared<std::atomic<int>>(0);
+            auto const count = [runs] { return std::packaged_task<void()>{[runs] { ++*runs; }}; };
+            when_any(manner, count(), count(), count()) | get();
+            CHECK(*runs >= 1);
+        }
+    }
+
     SECTION("task & task")
     {
         std::packaged_task<std::string()> hello{[] { return "Hello"s; }};
@@ -105,4 +132,73 @@ TEST_CASE("Test monadic operations on std::packaged_task")
         world = std::packaged_task<std::string()>{[] { return "World!"s; }};
         CHECK((when_all(std::move(hello), std::move(there), std::move(world)) | apply(merge) | get()) == "Hello, there, World!"s);
     }
+
+    SECTION("when_all(task...) with arguments")
+    {
+        for (auto const manner : {in::sequence, in::parallel, in::automatic}) {
+            std::packaged_task<std::string(std::string, std::string)> greet{[](std::string const& greeting, std::string const& name) {
+                return greeting + ", "s + name;
+            }};
+            std::packaged_task<int()> answer{[] { return 42; }};
+            std::packaged_task<std::size_t(std::string const&)> length{[](std::string const& s) { return s.size(); }};
+            auto all = when_all(manner, std::move(greet), std::move(answer), std::move(length));
+            static_assert(std::is_same_v<decltype(all),
+                std::packaged_task<std::tuple<std::string, int, std::size_t>(std::string, std::string, std::string const&)>>);
+            CHECK((std::move(all) | get("Hello"s, "World"s, "there"s)) == std::make_tuple("Hello, World"s, 42, std::size_t{5}));
+        }
+    }
+
+    SECTION("when_all(task...) over many operands")
+    {
+        auto const sum = [](in manner, auto... is) {
+            return when_all(manner, std::packaged_task<int()>{[is] { return static_cast<int>(is); }}...)
+                | apply([](auto... results) { return (results + ...); }) | get();
+        };
+        auto const sum_to = [&sum](in manner, auto indices) {
+            return std::apply([&](auto... is) { return sum(manner, is...); }, indices);
+        };
+        auto const to32 = [](auto... is) { return std::make_tuple(is...); };
+        auto const indices = std::apply(to32, [] {
+            std::array<std::size_t, 32> a{};
+            for (std::size_t i = 0; i < a.size(); ++i) {
+                a[i] = i;
+            }
+            return a;
+        }());
+        CHECK(sum_to(in::sequence, indices) == 31 * 32 / 2);
+        CHECK(sum_to(in::parallel, indices) == 31 * 32 / 2);
+
+        std::packaged_task<int()> one{[] { return 1; }};
+        std::packaged_task<int()> except{[]() -> int { throw std::runtime_error{"Exception!"}; }};
+        std::packaged_task<int()> two{[] { return 2; }};
+        CHECK_THROWS_AS(when_all(in::parallel, std::move(one), std::move(except), std::move(two)) | get(),
+                        std::runtime_error);
+    }
+
+    SECTION("task | start(...)")
+    {
+        std::promise<void> started;
+        auto has_started = started.get_future();
+        std::packaged_task<std::string(std::string const&)> hello{[&started](auto const& name) {
+            started.set_value();
+            return "Hello, "s + name;
+        }};
+
+        auto const running = std::move(hello) | start("World!"s);
+        // The task runs without anybody asking for its result.
+        CHECK(has_started.wait_for(std::chrono::seconds{10}) == std::future_status::ready);
+        CHECK((running | then([](auto const& s) { return s.size(); }) | get()) == 13);
+        CHECK((running | get()) == "Hello, World!"s);
+
+        std::packaged_task<std::string()> there{[] { return "there"s; }};
+        std::packaged_task<std::string()> world{[] { return "World!"s; }};
+        auto const both = when_all(in::parallel, std::move(there), std::move(world)) | start();
+        std::packaged_task<int()> other{[] { return 42; }};
+        CHECK(((in::sequence & both) & std::move(other) | get()) ==
+              std::make_tuple(std::make_tuple("there"s, "World!"s), 42));
+
+        std::packaged_task<int()> except{[]() -> int { throw std::runtime_error{"Exception!"}; }};
+        auto const failing = std::move(except) | start();
+        CHECK_THROWS_AS(failing | get(), std::runtime_error);
+    }
 }
@@ -0,0 +1,54 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/timer_queue.h"
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Test timer_queue")
+{
+    SECTION("a timer is not ready before its deadline")
+    {
+        sib::timer_queue timers;
+        auto const start = sib::timer_queue::clock::now();
+        auto future = timers.after(20ms);
+        CHECK(timers.pending() <= 1);
+        future.get();
+        CHECK(sib::timer_queue::clock::now() - start >= 20ms);
+        CHECK(timers.pending() == 0);
+    }
+
+    SECTION("timers fire in deadline order, whatever the order they were made in")
+    {
+        sib::timer_queue timers;
+        auto late = timers.after(1h);
+        auto soon = timers.after(10ms);
+        CHECK(soon.wait_for(5s) == std::future_status::ready);
+        CHECK(late.wait_for(0s) == std::future_status::timeout);
+        CHECK(timers.pending() == 1);
+    }
+
+    SECTION("callbacks are called at their deadlines")
+    {
+        sib::timer_queue timers;
+        auto const start = sib::timer_queue::clock::now();
+        std::promise<sib::timer_queue::clock::time_point> called;
+        timers.after(20ms, [&called] { called.set_value(sib::timer_queue::clock::now()); });
+        CHECK(called.get_future().get() - start >= 20ms);
+        CHECK(timers.pending() == 0);
+    }
+
+    SECTION("pending timers are dropped on destruction")
+    {
+        std::future<void> never;
+        {
+            sib::timer_queue timers;
+            never = timers.after(1h);
+        }
+        CHECK_THROWS_AS(never.get(), std::future_error);
+    }
+}
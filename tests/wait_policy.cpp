@@ -0,0 +1,112 @@
+// Copyright Stewart Becker 2024.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// https://www.boost.org/LICENSE_1_0.txt)
+#include <catch2/catch_test_macros.hpp>
+
+#include "sib/monad/task.h"
+#include "sib/thread_pool.h"
+#include <string>
+
+using namespace std::string_literals;
+
+TEST_CASE("Test wait policies")
+{
+    using namespace sib::monad;
+    using namespace std::chrono_literals;
+    using sib::wait_policy;
+
+    SECTION("spin counts")
+    {
+        CHECK(wait_policy::park().spin_iterations() == 0);
+        CHECK(wait_policy{}.spin_iterations() == 0);
+        CHECK(wait_policy::spin(100).spin_iterations() == 100);
+        CHECK(wait_policy::adaptive(1600).spin_iterations() == 100);
+    }
+
+    SECTION("wait returns once the future is ready")
+    {
+        for (auto const& policy : {wait_policy::park(), wait_policy::spin(1000), wait_policy::adaptive()}) {
+            std::promise<int> promise;
+            auto future = promise.get_future();
+            std::thread setter{[&promise] {
+                std::this_thread::sleep_for(1ms);
+                promise.set_value(42);
+            }};
+            policy.wait(future);
+            CHECK(future.wait_for(0s) == std::future_status::ready);
+            CHECK(future.get() == 42);
+            setter.join();
+        }
+    }
+
+    SECTION("adaptive policies learn")
+    {
+        auto const policy = wait_policy::adaptive(1u << 20);
+        auto const copy = policy;
+        auto const initial = policy.spin_iterations();
+
+        // Results that are always ready shrink the spin count towards the floor...
+        for (int i = 0; i < 100; ++i) {
+            CHECK(policy.spin_until([] { return true; }));
+        }
+        CHECK(policy.spin_iterations() < initial);
+        // ... and copies share what was learned.
+        CHECK(copy.spin_iterations() == policy.spin_iterations());
+
+        // Waits that would have ended with a little more spinning grow it again ...
+        auto const shrunk = policy.spin_iterations();
+        for (int i = 0; i < 10; ++i) {
+            policy.parked(10us, 1us);
+        }
+        CHECK(policy.spin_iterations() > shrunk);
+
+        // ... while long waits shrink it.
+        auto const grown = policy.spin_iterations();
+        for (int i = 0; i < 10; ++i) {
+            policy.parked(1us, 10ms);
+        }
+        CHECK(policy.spin_iterations() < grown);
+    }
+
+    SECTION("current_wait_policy")
+    {
+        CHECK(sib::current_wait_policy().spin_iterations() == 0);
+
+        sib::thread_pool pool{1};
+        pool.waits(wait_policy::spin(123));
+        {
+            sib::executor::scope const executor{&pool};
+            CHECK(sib::current_wait_policy().spin_iterations() == 123);
+            {
+                wait_policy::scope const scope{wait_policy::spin(456)};
+                CHECK(sib::current_wait_policy().spin_iterations() == 456);
+            }
+            CHECK(sib::current_wait_policy().spin_iterations() == 123);
+        }
+
+        std::promise<std::size_t> promise;
+        pool.submit([&promise] { promise.set_value(sib::current_wait_policy().spin_iterations()); });
+        CHECK(promise.get_future().get() == 123);
+    }
+
+    SECTION("task | get_with(...)")
+    {
+        std::packaged_task<std::size_t()> spins{[] { return sib::current_wait_policy().spin_iterations(); }};
+        CHECK((std::move(spins) | get_with(wait_policy::spin(789))) == 789);
+        CHECK(sib::current_wait_policy().spin_iterations() == 0);
+
+        std::packaged_task<std::string()> hello{[] { return "Hello"s; }};
+        std::packaged_task<std::string()> world{[] { return "World!"s; }};
+        auto const policy = wait_policy::adaptive();
+        CHECK(((in::parallel ^ std::move(hello) ^ std::move(world)) | get_with(policy)).size() > 0);
+
+        std::packaged_task<std::string(std::string const&)> greet{[](auto const& name) { return "Hello, "s + name; }};
+        std::packaged_task<std::string()> there{[] { return "there"s; }};
+        auto both = in::parallel & std::move(greet) & std::move(there);
+        CHECK((std::move(both) | get_with(policy, "World!"s)) == std::make_tuple("Hello, World!"s, "there"s));
+
+        sib::shared_task<int(int)> const twice{[](int x) { return 2 * x; }};
+        CHECK((twice | get_with(wait_policy::spin(10), 21)) == 42);
+    }
+}